@@ -0,0 +1,132 @@
+#include <iostream>
+#include <random>
+#include <thread>
+#include <cstdlib>
+#include "backend/problem.h"
+#include "backend/problem_batch_solver.h"
+#include "backend/base_fixed_vertex.h"
+#include "backend/base_fixed_edge.h"
+#include "utils/tic_toc.h"
+
+using namespace myslam::backend;
+using namespace std;
+
+/*
+ * 多个相互独立的曲线拟合问题 y = a*x^2 + b*x + c，每个问题对应一个传感器轴的标定
+ * 问题在多个线程中同时构造，再分别用单线程依次求解和 ProblemBatchSolver 并行求解，两者结果应完全相同
+ *
+ * 用法: ./batchCurveFitting [问题数量] [每个问题的观测数量] [线程数]
+ */
+
+class CurveFittingVertex: public BaseFixedVertex<3>
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+class CurveFittingEdge: public BaseFixedEdge<1, 3>
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    CurveFittingEdge( double x, double y ): BaseFixedEdge<1, 3>(std::vector<std::string>{"abc"}), x_(x), y_(y) {}
+
+    virtual void ComputeResidual() override
+    {
+        Eigen::Map<const Vec3> abc(verticies_[0]->Parameters().data());
+        FixedResidual()(0) = abc(0)*x_*x_ + abc(1)*x_ + abc(2) - y_;
+    }
+
+    virtual void ComputeJacobians() override
+    {
+        Jacobian<0>() << x_ * x_ , x_  , 1 ;
+    }
+
+    double x_,y_;
+};
+
+struct CalibrationTask
+{
+    std::unique_ptr<Problem> problem;
+    std::shared_ptr<CurveFittingVertex> vertex;
+};
+
+/// 第 k 个问题的真值为 (1 + k%7, 2 - k%5, k%3)，噪声的种子由 k 决定
+void BuildTask(int k, int N, CalibrationTask &task)
+{
+    std::default_random_engine generator(k);
+    std::normal_distribution<double> noise(0., 0.1);
+    double a = 1. + k % 7, b = 2. - k % 5, c = k % 3;
+
+    task.problem.reset(new Problem(Problem::ProblemType::GENERIC_PROBLEM));
+    task.vertex = task.problem->NewVertex<CurveFittingVertex>();
+    task.vertex->SetParameters(Eigen::Vector3d (0.,0.,0.));
+    task.problem->AddVertex(task.vertex);
+    for (int i = 0; i < N; ++i)
+    {
+        double x = i / static_cast<double>(N);
+        double y = a*x*x + b*x + c + noise(generator);
+        shared_ptr<CurveFittingEdge> edge = task.problem->NewEdge<CurveFittingEdge>(x, y);
+        edge->SetVertex(std::vector<std::shared_ptr<Vertex>>{task.vertex});
+        task.problem->AddEdge(edge);
+    }
+}
+
+/// 用 num_threads 个线程同时构造所有问题
+void BuildTasks(int M, int N, int num_threads, std::vector<CalibrationTask> &tasks)
+{
+    tasks.resize(M);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t)
+    {
+        threads.emplace_back([&tasks, M, N, t, num_threads]() {
+            for (int k = M * t / num_threads; k < M * (t + 1) / num_threads; ++k)
+                BuildTask(k, N, tasks[k]);
+        });
+    }
+    for (auto &thread: threads)
+        thread.join();
+}
+
+int main(int argc, char **argv)
+{
+    int M = argc > 1 ? atoi(argv[1]) : 300;
+    int N = argc > 2 ? atoi(argv[2]) : 2000;
+    int num_threads = argc > 3 ? atoi(argv[3]) : 0;
+
+    ProblemBatchSolver batch_solver(num_threads);
+    num_threads = batch_solver.NumThreads();
+
+    std::vector<CalibrationTask> sequential_tasks, batch_tasks;
+    BuildTasks(M, N, num_threads, sequential_tasks);
+    BuildTasks(M, N, num_threads, batch_tasks);
+
+    TicToc t_sequential;
+    for (auto &task: sequential_tasks)
+        task.problem->Solve(10);
+    double sequential_cost = t_sequential.toc();
+
+    std::vector<Problem *> problems;
+    for (auto &task: batch_tasks)
+        problems.push_back(task.problem.get());
+    TicToc t_batch;
+    const std::vector<ProblemBatchSolver::Result> &results = batch_solver.Solve(problems, 10);
+    double batch_cost = t_batch.toc();
+
+    int failed = 0;
+    double max_diff = 0., max_chi2 = 0.;
+    for (int k = 0; k < M; ++k)
+    {
+        if (!results[k].success) ++failed;
+        max_chi2 = std::max(max_chi2, results[k].summary.final_chi2);
+        max_diff = std::max(max_diff, (sequential_tasks[k].vertex->Parameters() -
+                                       batch_tasks[k].vertex->Parameters()).cwiseAbs().maxCoeff());
+    }
+
+    std::cout << "-------Batch CurveFitting, " << M << " problems x " << N << " edges, " << num_threads << " threads" << std::endl;
+    std::cout << "sequential : " << sequential_cost << " ms" << std::endl;
+    std::cout << "batch      : " << batch_cost << " ms, speedup " << sequential_cost / batch_cost << "x" << std::endl;
+    std::cout << "failed: " << failed << ", max final chi2: " << max_chi2
+              << ", max |sequential - batch|: " << max_diff << std::endl;
+    std::cout << "problem 0 abc = " << batch_tasks[0].vertex->Parameters().transpose() << std::endl;
+    return 0;
+}
@@ -0,0 +1,338 @@
+#include <iostream>
+#include <random>
+#include <algorithm>
+#include <cstdlib>
+#include "backend/problem.h"
+#include "backend/small_problem.h"
+#include "backend/base_fixed_vertex.h"
+#include "backend/base_fixed_edge.h"
+#include "backend/base_batch_edge.h"
+#include "backend/autodiff_edge.h"
+#include "utils/tic_toc.h"
+
+using namespace myslam::backend;
+using namespace std;
+
+/*
+ * 曲线拟合 y = a*x^2 + b*x + c 的四种实现对比:
+ *   动态: 与 CurveFitting.cpp 相同，残差和雅可比都是 VecX / MatXX
+ *   定长: BaseFixedVertex<3> + BaseFixedEdge<1, 3>，J^T W J 用定长矩阵计算
+ *   自动求导: AutoDiffEdge<Functor, 1, 3>，只写残差，雅可比由 Jet 求出
+ *   批量: 所有观测放在一条 BaseBatchEdge 中，SoA 存储，连同保存的残差每个观测 24 字节
+ * 以及很多个小问题 (例如每个 IMU 轴一个的尺度和零偏拟合) 用 Problem 和 SmallProblem<3> 分别求解的耗时
+ *
+ * 用法: ./benchCurveFitting [观测数量] [重复次数] [小问题个数] [每个小问题的观测数量]
+ */
+
+// 动态大小的顶点和边
+class CurveFittingVertex: public Vertex
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    CurveFittingVertex(): Vertex(3) {}
+};
+
+class CurveFittingEdge: public Edge
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    CurveFittingEdge( double x, double y ): Edge(1,1, std::vector<std::string>{"abc"}), x_(x), y_(y) {}
+
+    virtual void ComputeResidual() override
+    {
+        Vec3 abc = verticies_[0]->Parameters();
+        residual_(0) = abc(0)*x_*x_ + abc(1)*x_ + abc(2) - y_;
+    }
+
+    virtual void ComputeJacobians() override
+    {
+        Eigen::Matrix<double, 1, 3> jaco_abc;
+        jaco_abc << x_ * x_ , x_  , 1 ;
+        jacobians_[0] = jaco_abc;
+    }
+
+    double x_,y_;
+};
+
+// 定长的顶点和边
+class CurveFittingFixedVertex: public BaseFixedVertex<3>
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+class CurveFittingFixedEdge: public BaseFixedEdge<1, 3>
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    CurveFittingFixedEdge( double x, double y ): BaseFixedEdge<1, 3>(std::vector<std::string>{"abc"}), x_(x), y_(y) {}
+
+    virtual void ComputeResidual() override
+    {
+        Eigen::Map<const Vec3> abc(verticies_[0]->Parameters().data());
+        FixedResidual()(0) = abc(0)*x_*x_ + abc(1)*x_ + abc(2) - y_;
+    }
+
+    virtual void ComputeJacobians() override
+    {
+        Jacobian<0>() << x_ * x_ , x_  , 1 ;
+    }
+
+    double x_,y_;
+};
+
+// 自动求导的边，只需要模板的残差
+struct CurveFittingResidual
+{
+    CurveFittingResidual(double x, double y) : x_(x), y_(y) {}
+
+    template <typename T>
+    bool operator()(const T *abc, T *residual) const
+    {
+        residual[0] = abc[0]*x_*x_ + abc[1]*x_ + abc[2] - y_;
+        return true;
+    }
+
+    double x_,y_;
+};
+
+class CurveFittingAutoDiffEdge: public AutoDiffEdge<CurveFittingResidual, 1, 3>
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    CurveFittingAutoDiffEdge( double x, double y )
+        : AutoDiffEdge<CurveFittingResidual, 1, 3>(CurveFittingResidual(x, y), std::vector<std::string>{"abc"}) {}
+};
+
+/// CurveFitting.cpp 中注释掉的指数模型 y = exp(a*x^2 + b*x + c)，用来检查非线性函数的导数
+struct ExpCurveResidual
+{
+    template <typename T>
+    bool operator()(const T *abc, T *residual) const
+    {
+        using std::exp;
+        residual[0] = exp(abc[0]*x_*x_ + abc[1]*x_ + abc[2]) - y_;
+        return true;
+    }
+
+    double x_,y_;
+};
+
+// 批量的边，所有观测共享一个顶点
+class CurveFittingBatchEdge: public BaseBatchEdge<CurveFittingBatchEdge, 3>
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    double EvaluateResidual(double x, double y, const ParamType &abc) const
+    {
+        return abc(0)*x*x + abc(1)*x + abc(2) - y;
+    }
+
+    template <typename Row>
+    void EvaluateJacobian(double x, const ParamType &, Row &&J) const
+    {
+        J << x * x, x, 1;
+    }
+
+    /// 按列计算整块观测的雅可比
+    template <typename Block>
+    void EvaluateJacobians(const double *x, int n, const ParamType &, Block &&J) const
+    {
+        Eigen::Map<const VecX> xs(x, n);
+        J.col(0) = xs.cwiseAbs2();
+        J.col(1) = xs;
+        J.col(2).setOnes();
+    }
+};
+
+/// 构造并求解一次，返回求解耗时 (ms)
+template <typename VertexType, typename EdgeType>
+double RunOnce(int N, Vec3 &result)
+{
+    std::default_random_engine generator;
+    std::normal_distribution<double> noise(0., 1.);
+
+    Problem problem(Problem::ProblemType::GENERIC_PROBLEM);
+    shared_ptr<VertexType> vertex(new VertexType());
+    vertex->SetParameters(Eigen::Vector3d (0.,0.,0.));
+    problem.AddVertex(vertex);
+
+    for (int i = 0; i < N; ++i)
+    {
+        double x = i / static_cast<double>(N);
+        double y = x*x + 2.*x + 1. + noise(generator);
+        shared_ptr<EdgeType> edge(new EdgeType(x, y));
+        edge->SetVertex(std::vector<std::shared_ptr<Vertex>>{vertex});
+        problem.AddEdge(edge);
+    }
+
+    TicToc t_solve;
+    problem.Solve(10);
+    double cost = t_solve.toc();
+    result = vertex->Parameters();
+    return cost;
+}
+
+/// 批量的边只有一条，观测直接写进 SoA 数组
+double RunBatchOnce(int N, Vec3 &result)
+{
+    std::default_random_engine generator;
+    std::normal_distribution<double> noise(0., 1.);
+
+    Problem problem(Problem::ProblemType::GENERIC_PROBLEM);
+    shared_ptr<CurveFittingFixedVertex> vertex(new CurveFittingFixedVertex());
+    vertex->SetParameters(Eigen::Vector3d (0.,0.,0.));
+    problem.AddVertex(vertex);
+
+    shared_ptr<CurveFittingBatchEdge> edge(new CurveFittingBatchEdge());
+    edge->Reserve(N);
+    for (int i = 0; i < N; ++i)
+    {
+        double x = i / static_cast<double>(N);
+        double y = x*x + 2.*x + 1. + noise(generator);
+        edge->AddObservation(x, y);
+    }
+    edge->SetVertex(std::vector<std::shared_ptr<Vertex>>{vertex});
+    problem.AddEdge(edge);
+
+    TicToc t_solve;
+    problem.Solve(10);
+    double cost = t_solve.toc();
+    result = vertex->Parameters();
+    return cost;
+}
+
+/// 自动求导的雅可比与手写的雅可比之差的最大值
+double CheckAutoDiffJacobians()
+{
+    shared_ptr<CurveFittingFixedVertex> vertex(new CurveFittingFixedVertex());
+    vertex->SetParameters(Eigen::Vector3d (0.3, -1.2, 0.7));
+    std::vector<std::shared_ptr<Vertex>> vertices{vertex};
+
+    double max_diff = 0.;
+    for (int i = 0; i < 20; ++i)
+    {
+        double x = -1. + 0.1 * i, y = 2. - 0.05 * i;
+
+        CurveFittingEdge analytic(x, y);
+        CurveFittingAutoDiffEdge autodiff(x, y);
+        analytic.SetVertex(vertices);
+        autodiff.SetVertex(vertices);
+        analytic.ComputeResidual();
+        analytic.ComputeJacobians();
+        autodiff.ComputeResidual();
+        autodiff.ComputeJacobians();
+        max_diff = std::max(max_diff, (analytic.Jacobians()[0] - autodiff.Jacobians()[0]).cwiseAbs().maxCoeff());
+        max_diff = std::max(max_diff, std::abs(analytic.Residual()[0] - autodiff.Residual()[0]));
+
+        // 指数模型: d/dabc = exp(.) * [x^2, x, 1]
+        AutoDiffEdge<ExpCurveResidual, 1, 3> exp_edge(ExpCurveResidual{x, y});
+        exp_edge.SetVertex(vertices);
+        exp_edge.ComputeJacobians();
+        Vec3 abc = vertex->Parameters();
+        double exp_y = std::exp(abc(0)*x*x + abc(1)*x + abc(2));
+        Eigen::Matrix<double, 1, 3> jaco_abc;
+        jaco_abc << x * x * exp_y, x * exp_y , 1 * exp_y;
+        max_diff = std::max(max_diff, (jaco_abc - exp_edge.Jacobians()[0]).cwiseAbs().maxCoeff());
+    }
+    return max_diff;
+}
+
+/// 一个小问题: 一个顶点和 n 个观测
+template <typename ProblemType>
+shared_ptr<CurveFittingFixedVertex> AddSmallCurve(ProblemType &problem, int n, std::default_random_engine &generator)
+{
+    std::normal_distribution<double> noise(0., 0.01);
+    shared_ptr<CurveFittingFixedVertex> vertex(new CurveFittingFixedVertex());
+    vertex->SetParameters(Eigen::Vector3d (0.,0.,0.));
+    problem.AddVertex(vertex);
+    for (int i = 0; i < n; ++i)
+    {
+        double x = i / static_cast<double>(n);
+        double y = x*x + 2.*x + 1. + noise(generator);
+        shared_ptr<CurveFittingFixedEdge> edge(new CurveFittingFixedEdge(x, y));
+        edge->SetVertex(std::vector<std::shared_ptr<Vertex>>{vertex});
+        problem.AddEdge(edge);
+    }
+    return vertex;
+}
+
+/**
+ * 依次求解 count 个各有 n 个观测的小问题，返回求解的总耗时 (ms)，不含构造
+ * Problem 每次新建，SmallProblem 用同一个对象 Clear 后复用
+ */
+double RunSmallProblems(int count, int n, bool small, Vec3 &result)
+{
+    std::default_random_engine generator;
+    SmallProblem<3, CurveFittingFixedEdge> small_problem;
+    small_problem.Reserve(n);
+    double cost = 0.;
+    for (int k = 0; k < count; ++k)
+    {
+        if (small)
+        {
+            small_problem.Clear();
+            shared_ptr<CurveFittingFixedVertex> vertex = AddSmallCurve(small_problem, n, generator);
+            TicToc t_solve;
+            small_problem.Solve(10);
+            cost += t_solve.toc();
+            result = vertex->Parameters();
+        }
+        else
+        {
+            Problem problem(Problem::ProblemType::GENERIC_PROBLEM);
+            shared_ptr<CurveFittingFixedVertex> vertex = AddSmallCurve(problem, n, generator);
+            TicToc t_solve;
+            problem.Solve(10);
+            cost += t_solve.toc();
+            result = vertex->Parameters();
+        }
+    }
+    return cost;
+}
+
+double MedianCost(double (*run)(int, Vec3 &), int N, int repeat, Vec3 &result)
+{
+    std::vector<double> costs;
+    for (int r = 0; r < repeat; ++r)
+        costs.push_back(run(N, result));
+    std::sort(costs.begin(), costs.end());
+    return costs[costs.size() / 2];
+}
+
+int main(int argc, char **argv)
+{
+    int N = argc > 1 ? atoi(argv[1]) : 100000;
+    int repeat = argc > 2 ? atoi(argv[2]) : 5;
+    int small_count = argc > 3 ? atoi(argv[3]) : 20000;
+    int small_n = argc > 4 ? atoi(argv[4]) : 50;
+
+    Vec3 dynamic_result, fixed_result, autodiff_result, batch_result;
+    double dynamic_cost = MedianCost(RunOnce<CurveFittingVertex, CurveFittingEdge>, N, repeat, dynamic_result);
+    double fixed_cost = MedianCost(RunOnce<CurveFittingFixedVertex, CurveFittingFixedEdge>, N, repeat, fixed_result);
+    double autodiff_cost = MedianCost(RunOnce<CurveFittingFixedVertex, CurveFittingAutoDiffEdge>, N, repeat, autodiff_result);
+    double batch_cost = MedianCost(RunBatchOnce, N, repeat, batch_result);
+
+    std::cout << "-------CurveFitting benchmark, " << N << " edges, median of " << repeat << " solves" << std::endl;
+    std::cout << "dynamic Edge/Vertex  : " << dynamic_cost << " ms, abc = " << dynamic_result.transpose() << std::endl;
+    std::cout << "BaseFixedEdge<1, 3>  : " << fixed_cost << " ms, abc = " << fixed_result.transpose() << std::endl;
+    std::cout << "AutoDiffEdge<1, 3>   : " << autodiff_cost << " ms, abc = " << autodiff_result.transpose() << std::endl;
+    std::cout << "BaseBatchEdge<.., 3> : " << batch_cost << " ms, abc = " << batch_result.transpose() << std::endl;
+    std::cout << "speedup: fixed " << dynamic_cost / fixed_cost << "x, autodiff " << dynamic_cost / autodiff_cost
+              << "x, batch " << dynamic_cost / batch_cost << "x" << std::endl;
+    std::cout << "max |autodiff - analytic| jacobian: " << CheckAutoDiffJacobians() << std::endl;
+
+    Vec3 problem_result, small_result;
+    double problem_cost = RunSmallProblems(small_count, small_n, false, problem_result);
+    double small_cost = RunSmallProblems(small_count, small_n, true, small_result);
+    std::cout << "-------" << small_count << " small problems, " << small_n << " edges each, total solve time"
+              << std::endl;
+    std::cout << "Problem              : " << problem_cost << " ms (" << 1000. * problem_cost / small_count
+              << " us each), last abc = " << problem_result.transpose() << std::endl;
+    std::cout << "SmallProblem<3, ..>  : " << small_cost << " ms (" << 1000. * small_cost / small_count
+              << " us each), last abc = " << small_result.transpose() << std::endl;
+    std::cout << "speedup: " << problem_cost / small_cost << "x" << std::endl;
+    return 0;
+}
@@ -0,0 +1,513 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <random>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include "backend/problem.h"
+#include "backend/async_solver.h"
+#include "backend/vertex_pose.h"
+#include "backend/vertex_point_xyz.h"
+#include "backend/edge_reprojection.h"
+#include "utils/tic_toc.h"
+
+using namespace myslam::backend;
+using namespace std;
+
+/*
+ * 滑窗 BA 每帧求解的延迟
+ * 仿真的相机沿一面路标墙平移 (带小幅转动)，每帧加入一个位姿和它的观测；窗口超过 --window 帧时
+ * 边缘化最老的一帧以及以它为首次观测的路标，最老的一帧对其他路标的观测直接丢弃，先验只落在位姿上
+ * 每帧调用一次 Solve，各种停止条件跑同样的帧序列:
+ *   unbounded:  只限制迭代次数
+ *   solves=N:   最多解 N 次线性方程
+ *   budget=X:   截止时间为 Solve 开始后 X ms
+ * 报告窗口填满之后每帧 Solve 用时的 p50 / p90 / p99 / 最大值，平均的 chi2 和线性方程求解次数，以及停止原因的分布
+ * 最后用 AsyncSolver 在后台求解同样的帧序列: 帧以 --rate Hz 到来，另一个线程以 --read-rate Hz 读取最新的位姿，
+ * 报告读取的用时和读到的结果是否已经包含最新一帧 (--rate 0 时不运行)
+ *
+ * 用法: ./benchLatency [--frames N] [--window N] [--iterations N] [--solves N] [--budget ms]
+ *                      [--rate Hz] [--read-rate Hz] [--json 文件]
+ */
+
+const double kSpeed = 0.25;             // 每帧前进的距离 (m)
+const double kLandmarksPerMeter = 12.;
+
+/// 仿真的真值: 路标墙和相机轨迹，同样的种子总是生成同样的序列
+class Simulator
+{
+public:
+    explicit Simulator(int frames)
+    {
+        std::default_random_engine generator(1);
+        std::uniform_real_distribution<double> y_rand(-3., 3.);
+        std::uniform_real_distribution<double> z_rand(4., 10.);
+        double length = kSpeed * frames + 16.;
+        int count = static_cast<int>(length * kLandmarksPerMeter);
+        std::uniform_real_distribution<double> x_rand(-8., length - 8.);
+        for (int j = 0; j < count; ++j)
+            landmarks_.push_back(Vec3(x_rand(generator), y_rand(generator), z_rand(generator)));
+    }
+
+    int NumLandmarks() const { return static_cast<int>(landmarks_.size()); }
+    const Vec3 &Landmark(int j) const { return landmarks_[j]; }
+
+    /// 第 k 帧的位姿 Twc，相机朝 +z
+    void Pose(int k, Eigen::Matrix3d &R, Vec3 &t) const
+    {
+        R = Eigen::AngleAxisd(0.05 * sin(0.13 * k), Vec3::UnitY()) * Eigen::AngleAxisd(0.03 * sin(0.11 * k), Vec3::UnitX());
+        t = Vec3(kSpeed * k, 0.3 * sin(0.1 * k), 0.2 * cos(0.07 * k));
+    }
+
+    /// 路标 j 在第 k 帧中是否可见，可见时给出归一化平面上的 (无噪声) 投影
+    bool Project(int k, int j, Vec2 &uv) const
+    {
+        Eigen::Matrix3d R;
+        Vec3 t;
+        Pose(k, R, t);
+        Vec3 Pc = R.transpose() * (landmarks_[j] - t);
+        if (Pc.z() < 1.)
+            return false;
+        uv = Vec2(Pc.x() / Pc.z(), Pc.y() / Pc.z());
+        return std::abs(uv.x()) < 0.7 && std::abs(uv.y()) < 0.5;
+    }
+
+private:
+    std::vector<Vec3> landmarks_;
+};
+
+struct LatencyConfig
+{
+    std::string name;
+    SolveOptions options;
+    double budget = 0.;     // > 0 时每帧的截止时间为 Solve 开始后 budget ms
+};
+
+struct LatencyResult
+{
+    std::string name;
+    std::vector<double> latencies;      // 窗口填满之后每帧的 Solve 用时 (ms)
+    double mean_chi2 = 0.;
+    double mean_linear_solves = 0.;
+    std::map<std::string, int> stop_reasons;
+};
+
+/// 有序数组的 p 分位数
+double Percentile(const std::vector<double> &sorted, double p)
+{
+    if (sorted.empty())
+        return 0.;
+    size_t index = static_cast<size_t>(std::ceil(p * sorted.size()));
+    return sorted[std::min(sorted.size() - 1, index > 0 ? index - 1 : 0)];
+}
+
+/**
+ * 滑窗的前端: 决定每一帧加入哪些顶点和边、边缘化哪些，一帧的改动打包成一条作用于 Problem 的命令
+ * 同步求解时直接执行，异步求解时交给 AsyncSolver；前端只把顶点和边当作句柄，不读它们的参数
+ * 前两帧固定以消除尺度和姿态的自由度，它们被边缘化之后先验接替这个作用
+ */
+class SlidingWindowFrontEnd
+{
+public:
+    SlidingWindowFrontEnd(const Simulator &sim, int window)
+        : sim_(sim), window_(window), landmarks_(sim.NumLandmarks()), generator_(2),
+          pixel_noise_(0., 1. / 1000.), pose_noise_(0., 0.02), point_noise_(0., 0.1) {}
+
+    /// 第 k 帧的改动: 新的位姿、路标和观测，窗口满时边缘化最老的一帧
+    std::function<void(Problem &)> AddFrame(int k)
+    {
+        auto update = std::make_shared<FrameUpdate>();
+
+        // 新的一帧，位姿初值为真值加噪声
+        Eigen::Matrix3d R;
+        Vec3 t;
+        sim_.Pose(k, R, t);
+        Eigen::Quaterniond q(R);
+        Vec3 initial = k > 1 ? Vec3(t + Vec3(pose_noise_(generator_), pose_noise_(generator_), pose_noise_(generator_))) : t;
+        VecX pose(7);
+        pose << initial, q.x(), q.y(), q.z(), q.w();
+        Frame frame;
+        frame.index = k;
+        frame.camera = std::make_shared<VertexPose>();
+        frame.camera->SetParameters(pose);
+        if (k < 2)
+            frame.camera->SetFixed();
+        update->verticies.push_back(frame.camera);
+
+        // 路标在相邻两帧中都可见时才加入，此前的那一帧作为它的首次观测
+        for (int j = 0; j < sim_.NumLandmarks(); ++j)
+        {
+            Vec2 uv;
+            if (landmarks_[j].removed || !sim_.Project(k, j, uv))
+                continue;
+            if (!landmarks_[j].point)
+            {
+                Vec2 uv_prev;
+                if (frames_.empty() || !sim_.Project(k - 1, j, uv_prev))
+                    continue;
+                landmarks_[j].point = std::make_shared<VertexPointXYZ>();
+                landmarks_[j].point->SetParameters(Vec3(sim_.Landmark(j) + Vec3(point_noise_(generator_),
+                                                                                point_noise_(generator_),
+                                                                                point_noise_(generator_))));
+                landmarks_[j].anchor = k - 1;
+                update->verticies.push_back(landmarks_[j].point);
+                Observe(frames_.back(), j, uv_prev, *update);
+            }
+            Observe(frame, j, uv, *update);
+        }
+        frames_.push_back(frame);
+
+        // 窗口满了: 边缘化最老的一帧和以它为首次观测的路标，它对其他路标的观测直接丢弃
+        if (static_cast<int>(frames_.size()) > window_)
+        {
+            Frame &oldest = frames_.front();
+            update->marg.push_back(oldest.camera);
+            for (auto &observation: oldest.observations)
+            {
+                Landmark &landmark = landmarks_[observation.second];
+                if (landmark.anchor == oldest.index)
+                {
+                    update->marg.push_back(landmark.point);
+                    landmark.removed = true;
+                    landmark.point.reset();
+                }
+                else
+                {
+                    update->removed_edges.push_back(observation.first);
+                }
+            }
+            frames_.pop_front();
+        }
+
+        return [update](Problem &problem) {
+            for (auto &vertex: update->verticies)
+                problem.AddVertex(vertex);
+            for (auto &edge: update->edges)
+                problem.AddEdge(edge);
+            for (auto &edge: update->removed_edges)
+                problem.RemoveEdge(edge);
+            if (!update->marg.empty())
+                problem.MarginalizeFrame(update->marg);
+        };
+    }
+
+    /// 最新一帧的位姿顶点 id
+    unsigned long LatestCameraId() const { return frames_.back().camera->Id(); }
+
+private:
+    struct Frame
+    {
+        int index;
+        shared_ptr<VertexPose> camera;
+        std::vector<std::pair<shared_ptr<Edge>, int>> observations;    // 边以及对应的路标
+    };
+    struct Landmark
+    {
+        shared_ptr<VertexPointXYZ> point;
+        int anchor = -1;        // 第一次被观测的帧
+        bool removed = false;   // 已经被边缘化
+    };
+    struct FrameUpdate
+    {
+        std::vector<std::shared_ptr<Vertex>> verticies;
+        std::vector<std::shared_ptr<Edge>> edges;
+        std::vector<std::shared_ptr<Edge>> removed_edges;
+        std::vector<std::shared_ptr<Vertex>> marg;
+    };
+
+    void Observe(Frame &frame, int j, const Vec2 &uv, FrameUpdate &update)
+    {
+        Vec2 obs(uv.x() + pixel_noise_(generator_), uv.y() + pixel_noise_(generator_));
+        shared_ptr<EdgeReprojectionXYZ> edge = std::make_shared<EdgeReprojectionXYZ>(obs);
+        edge->SetVertex(std::vector<std::shared_ptr<Vertex>>{landmarks_[j].point, frame.camera});
+        update.edges.push_back(edge);
+        frame.observations.push_back(std::make_pair(edge, j));
+    }
+
+    const Simulator &sim_;
+    int window_;
+    std::deque<Frame> frames_;
+    std::vector<Landmark> landmarks_;
+    std::default_random_engine generator_;
+    std::normal_distribution<double> pixel_noise_;
+    std::normal_distribution<double> pose_noise_;
+    std::normal_distribution<double> point_noise_;
+};
+
+/// 用 config 的停止条件同步地跑完整个帧序列，每帧求解一次
+LatencyResult RunSlidingWindow(const Simulator &sim, int frames, int window, const LatencyConfig &config)
+{
+    SlidingWindowFrontEnd front_end(sim, window);
+    Problem problem(Problem::ProblemType::SLAM_PROBLEM);
+    LatencyResult result;
+    result.name = config.name;
+    int measured = 0;
+
+    for (int k = 0; k < frames; ++k)
+    {
+        front_end.AddFrame(k)(problem);
+        if (k == 0)
+            continue;   // 只有一个固定的位姿，没有观测
+        SolveOptions options = config.options;
+        TicToc t_solve;
+        if (config.budget > 0.)
+            options.deadline = std::chrono::steady_clock::now() +
+                               std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                   std::chrono::duration<double, std::milli>(config.budget));
+        problem.Solve(options);
+        double latency = t_solve.toc();
+
+        if (k < window)
+            continue;
+        const SolverSummary &summary = problem.Summary();
+        result.latencies.push_back(latency);
+        result.mean_chi2 += summary.final_chi2;
+        result.mean_linear_solves += summary.linear_solves;
+        ++result.stop_reasons[StopReasonName(summary.stop_reason)];
+        ++measured;
+    }
+    if (measured > 0)
+    {
+        result.mean_chi2 /= measured;
+        result.mean_linear_solves /= measured;
+    }
+    std::sort(result.latencies.begin(), result.latencies.end());
+    return result;
+}
+
+struct AsyncResult
+{
+    unsigned long solves = 0;
+    std::vector<double> reads;          // 每次读取最新位姿的用时 (us)
+    double fresh = 0.;                  // 读到最新一帧优化结果的比例
+    double final_chi2 = 0.;
+};
+
+/**
+ * 异步求解: 帧以 rate Hz 到来，交给 AsyncSolver 后立即返回；另一个线程以 read_rate Hz 读取最新一帧的位姿
+ * (相当于 IMU 递推)，读取不加锁，统计每次读取的用时以及读到的结果是否已经包含最新一帧
+ */
+AsyncResult RunAsync(const Simulator &sim, int frames, int window, double rate, double read_rate,
+                     const LatencyConfig &config)
+{
+    AsyncSolver solver(Problem::ProblemType::SLAM_PROBLEM, config.options);
+    solver.SetTimeBudget(config.budget);
+    SlidingWindowFrontEnd front_end(sim, window);
+    AsyncResult result;
+
+    std::atomic<unsigned long> latest_camera(0);
+    std::atomic<bool> done(false);
+    long fresh = 0;
+    std::thread reader([&] {
+        VecX pose;
+        auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(1. / read_rate));
+        auto next = std::chrono::steady_clock::now();
+        while (!done.load())
+        {
+            unsigned long camera = latest_camera.load();
+            if (camera > 0)
+            {
+                TicToc t_read;
+                bool found = solver.GetParameters(camera, pose);
+                result.reads.push_back(t_read.toc() * 1000.);
+                fresh += found;
+            }
+            next += period;
+            std::this_thread::sleep_until(next);
+        }
+    });
+
+    auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(1. / rate));
+    auto next = std::chrono::steady_clock::now();
+    std::function<void(Problem &)> first_frame;
+    unsigned long ticket = 0;
+    for (int k = 0; k < frames; ++k)
+    {
+        std::function<void(Problem &)> update = front_end.AddFrame(k);
+        if (k == 0)
+        {
+            first_frame = update;   // 只有一个固定的位姿，和下一帧一起提交
+            continue;
+        }
+        if (first_frame)
+        {
+            std::function<void(Problem &)> second_frame = update;
+            update = [first_frame, second_frame](Problem &problem) {
+                first_frame(problem);
+                second_frame(problem);
+            };
+            first_frame = nullptr;
+        }
+        ticket = solver.Post(update);
+        latest_camera.store(front_end.LatestCameraId());
+        next += period;
+        std::this_thread::sleep_until(next);
+    }
+    solver.WaitUntilApplied(ticket);
+    done.store(true);
+    reader.join();
+
+    AsyncSolver::Estimate estimate;
+    solver.GetEstimate(estimate);
+    result.solves = estimate.sequence;
+    result.final_chi2 = estimate.summary.final_chi2;
+    result.fresh = result.reads.empty() ? 0. : static_cast<double>(fresh) / result.reads.size();
+    std::sort(result.reads.begin(), result.reads.end());
+    return result;
+}
+
+void PrintRow(const LatencyResult &r)
+{
+    std::ostringstream reasons;
+    for (auto &item: r.stop_reasons)
+        reasons << item.first << ":" << item.second << " ";
+    std::cout << std::left << std::setw(14) << r.name << std::right << std::setw(7) << r.latencies.size()
+              << std::setprecision(4)
+              << std::setw(10) << Percentile(r.latencies, 0.5)
+              << std::setw(10) << Percentile(r.latencies, 0.9)
+              << std::setw(10) << Percentile(r.latencies, 0.99)
+              << std::setw(10) << (r.latencies.empty() ? 0. : r.latencies.back())
+              << std::setw(10) << r.mean_linear_solves
+              << std::setw(12) << r.mean_chi2 << "  " << reasons.str() << std::endl;
+}
+
+void WriteJson(std::ostream &os, int frames, int window, const std::vector<LatencyResult> &results,
+               double rate, double read_rate, const AsyncResult &async)
+{
+    os << "{\n";
+    os << "  \"benchmark\": \"latency\",\n";
+    os << "  \"frames\": " << frames << ",\n";
+    os << "  \"window\": " << window << ",\n";
+    os << "  \"results\": [";
+    for (size_t k = 0; k < results.size(); ++k)
+    {
+        const LatencyResult &r = results[k];
+        os << (k == 0 ? "\n" : ",\n") << "    {";
+        os << "\"config\": \"" << r.name << "\", ";
+        os << "\"samples\": " << r.latencies.size() << ", ";
+        os << std::setprecision(10);
+        os << "\"p50_ms\": " << Percentile(r.latencies, 0.5) << ", ";
+        os << "\"p90_ms\": " << Percentile(r.latencies, 0.9) << ", ";
+        os << "\"p99_ms\": " << Percentile(r.latencies, 0.99) << ", ";
+        os << "\"max_ms\": " << (r.latencies.empty() ? 0. : r.latencies.back()) << ", ";
+        os << "\"mean_linear_solves\": " << r.mean_linear_solves << ", ";
+        os << "\"mean_chi2\": " << r.mean_chi2 << ", ";
+        os << "\"stop_reasons\": {";
+        bool first = true;
+        for (auto &item: r.stop_reasons)
+        {
+            os << (first ? "" : ", ") << "\"" << item.first << "\": " << item.second;
+            first = false;
+        }
+        os << "}}";
+    }
+    os << "\n  ]";
+    if (rate > 0.)
+    {
+        os << ",\n  \"async\": {";
+        os << "\"rate_hz\": " << rate << ", ";
+        os << "\"read_rate_hz\": " << read_rate << ", ";
+        os << "\"solves\": " << async.solves << ", ";
+        os << "\"reads\": " << async.reads.size() << ", ";
+        os << "\"read_p50_us\": " << Percentile(async.reads, 0.5) << ", ";
+        os << "\"read_p99_us\": " << Percentile(async.reads, 0.99) << ", ";
+        os << "\"read_max_us\": " << (async.reads.empty() ? 0. : async.reads.back()) << ", ";
+        os << "\"fresh\": " << async.fresh << ", ";
+        os << "\"final_chi2\": " << async.final_chi2 << "}";
+    }
+    os << "\n}\n";
+}
+
+int main(int argc, char **argv)
+{
+    int frames = 300;
+    int window = 10;
+    int iterations = 10;
+    int solves = 3;
+    double budget = 2.;
+    double rate = 30.;
+    double read_rate = 200.;
+    std::string json_path;
+    for (int k = 1; k < argc; ++k)
+    {
+        std::string arg = argv[k];
+        if (arg == "--frames" && k + 1 < argc) frames = atoi(argv[++k]);
+        else if (arg == "--window" && k + 1 < argc) window = std::max(2, atoi(argv[++k]));
+        else if (arg == "--iterations" && k + 1 < argc) iterations = atoi(argv[++k]);
+        else if (arg == "--solves" && k + 1 < argc) solves = atoi(argv[++k]);
+        else if (arg == "--budget" && k + 1 < argc) budget = atof(argv[++k]);
+        else if (arg == "--rate" && k + 1 < argc) rate = atof(argv[++k]);
+        else if (arg == "--read-rate" && k + 1 < argc) read_rate = std::max(1., atof(argv[++k]));
+        else if (arg == "--json" && k + 1 < argc) json_path = argv[++k];
+        else
+        {
+            std::cerr << "usage: " << argv[0]
+                      << " [--frames N] [--window N] [--iterations N] [--solves N] [--budget ms]"
+                      << " [--rate Hz] [--read-rate Hz] [--json file]"
+                      << std::endl;
+            return -1;
+        }
+    }
+
+    std::vector<LatencyConfig> configs(3);
+    configs[0].name = "unbounded";
+    configs[0].options.max_iterations = iterations;
+    configs[1].name = "solves=" + std::to_string(solves);
+    configs[1].options.max_iterations = iterations;
+    configs[1].options.max_linear_solves = solves;
+    std::ostringstream budget_name;
+    budget_name << "budget=" << budget;
+    configs[2].name = budget_name.str();
+    configs[2].options.max_iterations = iterations;
+    configs[2].budget = budget;
+
+    Simulator sim(frames);
+    std::cout << frames << " frames, window " << window << ", " << sim.NumLandmarks() << " landmarks, times in ms"
+              << std::endl;
+    std::cout << std::left << std::setw(14) << "config" << std::right << std::setw(7) << "frames"
+              << std::setw(10) << "p50" << std::setw(10) << "p90" << std::setw(10) << "p99" << std::setw(10) << "max"
+              << std::setw(10) << "solves" << std::setw(12) << "chi2" << "  stop reasons" << std::endl;
+    std::vector<LatencyResult> results;
+    for (const LatencyConfig &config: configs)
+    {
+        results.push_back(RunSlidingWindow(sim, frames, window, config));
+        PrintRow(results.back());
+    }
+
+    AsyncResult async;
+    if (rate > 0.)
+    {
+        async = RunAsync(sim, frames, window, rate, read_rate, configs[0]);
+        std::cout << "async: " << frames << " frames at " << rate << " Hz in " << async.solves << " solves, "
+                  << async.reads.size() << " reads at " << read_rate << " Hz: p50 " << Percentile(async.reads, 0.5)
+                  << " us, p99 " << Percentile(async.reads, 0.99) << " us, max "
+                  << (async.reads.empty() ? 0. : async.reads.back()) << " us, latest frame solved in "
+                  << 100. * async.fresh << "% of reads, final chi2 " << async.final_chi2 << std::endl;
+    }
+
+    if (!json_path.empty())
+    {
+        std::ofstream file(json_path);
+        if (!file.is_open())
+        {
+            std::cerr << "cannot open " << json_path << std::endl;
+            return -1;
+        }
+        WriteJson(file, frames, window, results, rate, read_rate, async);
+        std::cout << "results written to " << json_path << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,421 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <random>
+#include <memory>
+#include <functional>
+#include <string>
+#include <vector>
+#include <thread>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <sys/resource.h>
+#include "utils/tic_toc.h"
+#include "benchmark_problems.h"
+
+using namespace myslam::backend;
+using namespace std;
+
+/*
+ * 后端的基准测试，按以下几个维度扫描:
+ *   curve:     曲线拟合 y = a*x^2 + b*x + c，边数从 1e3 到 --max-edges，逐条边装配和分组装配各一次
+ *   posegraph: 2D 位姿图 (里程计 + 回环)，顶点数和回环密度 (每个顶点的回环数)
+ *   ba:        合成的 BA，相机数和密度 (每个路标被多少个相机观测)
+ *   mixed:     三种边交错加入的 2D 位姿图 (相对位姿、先验、平滑项)，比较边类型未注册 (虚函数) 与
+ *              RegisterEdgeType 注册后的线性化吞吐量
+ * 每个问题在各线程数和 DENSE / SPARSE / ITERATIVE 三种线性求解方式下各求解一次
+ *
+ * 每一项报告:
+ *   吞吐量: 每秒线性化的边数 = 边数 * 线性化次数 / 线性化总时间
+ *   Problem::Summary() 中各阶段的时间
+ *   进程的峰值 RSS (到这一项为止的最大值，各项按规模从小到大运行)
+ *   Solve 期间 malloc 的次数 (只在 glibc 下统计，其他平台为 -1)
+ * 终端输出表格，--json 给定文件时同时写出 JSON，便于不同版本之间比较
+ *
+ * 用法: ./benchSuite [--json 文件] [--max-edges N] [--threads 1,2,4] [--iterations N] [--quick]
+ */
+
+/// 进程的峰值 RSS (KB)
+static long PeakRssKB()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+// ---------------------------------------------------------------- 多种边
+/// 单个位姿的先验 (例如 GNSS)，残差 p - prior
+class Pose2DPriorEdge: public BaseFixedEdge<3, 3>
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    Pose2DPriorEdge(const Vec3 &prior): BaseFixedEdge<3, 3>(), prior_(prior)
+    {
+        Jacobian<0>().setIdentity();
+    }
+
+    virtual void ComputeResidual() override
+    {
+        Eigen::Map<const Vec3> pose(verticies_[0]->Parameters().data());
+        FixedResidual() = pose - prior_;
+        FixedResidual()[2] = std::remainder(FixedResidual()[2], 2. * M_PI);
+    }
+
+    /// 雅可比为单位阵，构造时已经写好
+    virtual void ComputeJacobians() override {}
+
+    Vec3 prior_;
+};
+
+/// 连续三个位姿平移的二阶差分 t_i - 2 t_j + t_k 与观测值之差
+class Pose2DSmoothnessEdge: public BaseFixedEdge<2, 3, 3, 3>
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    Pose2DSmoothnessEdge(const Vec2 &measurement): BaseFixedEdge<2, 3, 3, 3>(), measurement_(measurement)
+    {
+        Jacobian<0>() << 1., 0., 0., 0., 1., 0.;
+        Jacobian<1>() << -2., 0., 0., 0., -2., 0.;
+        Jacobian<2>() << 1., 0., 0., 0., 1., 0.;
+    }
+
+    virtual void ComputeResidual() override
+    {
+        Eigen::Map<const Vec2> t_i(verticies_[0]->Parameters().data());
+        Eigen::Map<const Vec2> t_j(verticies_[1]->Parameters().data());
+        Eigen::Map<const Vec2> t_k(verticies_[2]->Parameters().data());
+        FixedResidual() = t_i - 2. * t_j + t_k - measurement_;
+    }
+
+    virtual void ComputeJacobians() override {}
+
+    Vec2 measurement_;
+};
+
+/**
+ * 与 BuildPoseGraph 同样的绕圈轨迹，每个位姿依次加入: 里程计、与前两个位姿的平滑项、
+ * 每 10 个位姿一个先验、以 0.1 的概率回环，三种边在 edgeList_ 中交错出现
+ * registered 为 true 时三种边都注册专用的计算核
+ */
+std::unique_ptr<Problem> BuildMixedGraph(int num_poses, bool registered)
+{
+    const int kPosesPerLap = 200;
+    const int kPriorInterval = 10;
+    const double kRadius = 20.;
+    std::default_random_engine generator;
+    std::normal_distribution<double> noise(0., 0.01);
+    std::uniform_real_distribution<double> uniform(0., 1.);
+
+    std::vector<Vec3> truth(num_poses);
+    for (int i = 0; i < num_poses; ++i)
+    {
+        double angle = 2. * M_PI * i / kPosesPerLap;
+        truth[i] = Vec3(kRadius * cos(angle), kRadius * sin(angle), std::remainder(angle + M_PI / 2., 2. * M_PI));
+    }
+    auto Measure = [&](int i, int j) {
+        double c = cos(truth[i][2]), s = sin(truth[i][2]);
+        Vec3 d = truth[j] - truth[i];
+        return Vec3(c * d[0] + s * d[1] + noise(generator), c * d[1] - s * d[0] + noise(generator),
+                    std::remainder(d[2], 2. * M_PI) + noise(generator));
+    };
+
+    std::unique_ptr<Problem> problem(new Problem(Problem::ProblemType::GENERIC_PROBLEM));
+    if (registered)
+    {
+        problem->RegisterEdgeType<RelativePose2DEdge>();
+        problem->RegisterEdgeType<Pose2DPriorEdge>();
+        problem->RegisterEdgeType<Pose2DSmoothnessEdge>();
+    }
+    std::vector<shared_ptr<Pose2DVertex>> poses(num_poses);
+    auto Connect = [&](int i, int j) {
+        auto edge = problem->NewEdge<RelativePose2DEdge>(RelativePose2DResidual(Measure(i, j)));
+        edge->SetVertex(std::vector<std::shared_ptr<Vertex>>{poses[i], poses[j]});
+        problem->AddEdge(edge);
+    };
+    for (int i = 0; i < num_poses; ++i)
+    {
+        poses[i] = problem->NewVertex<Pose2DVertex>();
+        poses[i]->SetParameters(Vec3(truth[i] + Vec3(10. * noise(generator), 10. * noise(generator), noise(generator))));
+        problem->AddVertex(poses[i]);
+
+        if (i > 0)
+            Connect(i - 1, i);
+        if (i > 1)
+        {
+            Vec2 second = (truth[i - 2] - 2. * truth[i - 1] + truth[i]).head<2>();
+            auto edge = problem->NewEdge<Pose2DSmoothnessEdge>(Vec2(second + Vec2(noise(generator), noise(generator))));
+            edge->SetVertex(std::vector<std::shared_ptr<Vertex>>{poses[i - 2], poses[i - 1], poses[i]});
+            problem->AddEdge(edge);
+        }
+        if (i % kPriorInterval == 0)
+        {
+            auto edge = problem->NewEdge<Pose2DPriorEdge>(Vec3(truth[i] + Vec3(noise(generator), noise(generator), 0.)));
+            edge->SetVertex(std::vector<std::shared_ptr<Vertex>>{poses[i]});
+            problem->AddEdge(edge);
+        }
+        if (i >= kPosesPerLap && uniform(generator) < 0.1)
+            Connect(i - kPosesPerLap, i);
+    }
+    return problem;
+}
+
+// ---------------------------------------------------------------- 运行与输出
+struct Scenario
+{
+    std::string suite;
+    std::string size_name;      // 扫描的规模参数名
+    double size;
+    std::string density_name;   // 扫描的密度参数名，没有时为空
+    double density;
+    unsigned long parameters;   // 优化变量的维数，用来跳过太大的稠密求解
+    std::function<std::unique_ptr<Problem>()> build;
+    std::string variant;        // 同一问题的不同配置 (例如边的分派方式)，没有时为空
+};
+
+struct BenchmarkResult
+{
+    Scenario scenario;
+    std::string solver;
+    int threads = 1;
+    double build_time = 0.;
+    int linearizations = 0;
+    double edges_per_second = 0.;
+    long mallocs = 0;
+    long peak_rss_kb = 0;
+    SolverSummary summary;
+};
+
+const char *SolverName(Problem::LinearSolverType type)
+{
+    switch (type)
+    {
+        case Problem::LinearSolverType::DENSE: return "dense";
+        case Problem::LinearSolverType::SPARSE: return "sparse";
+        case Problem::LinearSolverType::ITERATIVE: return "iterative";
+        default: return "auto";
+    }
+}
+
+BenchmarkResult Run(const Scenario &scenario, Problem::LinearSolverType solver, int threads, int iterations)
+{
+    BenchmarkResult result;
+    result.scenario = scenario;
+    result.solver = SolverName(solver);
+    result.threads = threads;
+
+    TicToc t_build;
+    std::unique_ptr<Problem> problem = scenario.build();
+    result.build_time = t_build.toc();
+    problem->SetLinearSolverType(solver);
+    problem->SetNumThreads(threads);
+
+    long mallocs = MallocCount();
+    problem->Solve(iterations);
+    result.mallocs = mallocs < 0 ? -1 : MallocCount() - mallocs;
+    result.peak_rss_kb = PeakRssKB();
+    result.summary = problem->Summary();
+
+    // 开始时线性化一次，之后每个被接受的步长线性化一次
+    result.linearizations = 1;
+    for (const IterationSummary &step: result.summary.iterations)
+        result.linearizations += step.accepted ? 1 : 0;
+    if (result.summary.linearization_time > 0.)
+        result.edges_per_second = 1e3 * result.summary.num_edges * result.linearizations /
+                                  result.summary.linearization_time;
+    return result;
+}
+
+void PrintRow(const BenchmarkResult &r)
+{
+    std::ostringstream size;
+    size << r.scenario.size_name << "=" << r.scenario.size;
+    if (!r.scenario.density_name.empty())
+        size << " " << r.scenario.density_name << "=" << r.scenario.density;
+    if (!r.scenario.variant.empty())
+        size << " " << r.scenario.variant;
+    std::cout << std::left << std::setw(10) << r.scenario.suite << std::setw(40) << size.str()
+              << std::setw(10) << r.solver << std::right << std::setw(3) << r.threads
+              << std::setw(10) << r.summary.num_edges
+              << std::setw(12) << std::setprecision(4) << r.edges_per_second
+              << std::setw(10) << r.summary.total_time
+              << std::setw(10) << r.summary.linearization_time
+              << std::setw(10) << r.summary.linear_solver_time
+              << std::setw(9) << r.mallocs
+              << std::setw(10) << r.peak_rss_kb
+              << std::setw(12) << r.summary.final_chi2 << std::endl;
+}
+
+/// JSON 中的数值，inf / nan 写成 null
+std::string JsonNumber(double value)
+{
+    if (!std::isfinite(value))
+        return "null";
+    std::ostringstream os;
+    os << std::setprecision(10) << value;
+    return os.str();
+}
+
+void WriteJson(std::ostream &os, const std::vector<BenchmarkResult> &results)
+{
+    os << "{\n";
+    os << "  \"benchmark\": \"backend\",\n";
+#ifdef NDEBUG
+    os << "  \"assertions\": false,\n";
+#else
+    os << "  \"assertions\": true,\n";
+#endif
+    os << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n";
+    os << "  \"results\": [";
+    for (size_t k = 0; k < results.size(); ++k)
+    {
+        const BenchmarkResult &r = results[k];
+        const SolverSummary &s = r.summary;
+        os << (k == 0 ? "\n" : ",\n") << "    {";
+        os << "\"suite\": \"" << r.scenario.suite << "\", ";
+        os << "\"" << r.scenario.size_name << "\": " << JsonNumber(r.scenario.size) << ", ";
+        if (!r.scenario.density_name.empty())
+            os << "\"" << r.scenario.density_name << "\": " << JsonNumber(r.scenario.density) << ", ";
+        if (!r.scenario.variant.empty())
+            os << "\"variant\": \"" << r.scenario.variant << "\", ";
+        os << "\"solver\": \"" << r.solver << "\", ";
+        os << "\"threads\": " << r.threads << ", ";
+        os << "\"vertices\": " << s.num_vertices << ", ";
+        os << "\"edges\": " << s.num_edges << ", ";
+        os << "\"parameters\": " << s.num_parameters << ", ";
+        os << "\"iterations\": " << s.iterations.size() << ", ";
+        os << "\"linearizations\": " << r.linearizations << ", ";
+        os << "\"edges_per_second\": " << JsonNumber(r.edges_per_second) << ", ";
+        os << "\"build_ms\": " << JsonNumber(r.build_time) << ", ";
+        os << "\"total_ms\": " << JsonNumber(s.total_time) << ", ";
+        os << "\"linearization_ms\": " << JsonNumber(s.linearization_time) << ", ";
+        os << "\"damping_ms\": " << JsonNumber(s.damping_time) << ", ";
+        os << "\"linear_solver_ms\": " << JsonNumber(s.linear_solver_time) << ", ";
+        os << "\"update_ms\": " << JsonNumber(s.update_time) << ", ";
+        os << "\"residual_ms\": " << JsonNumber(s.residual_time) << ", ";
+        os << "\"initial_chi2\": " << JsonNumber(s.initial_chi2) << ", ";
+        os << "\"final_chi2\": " << JsonNumber(s.final_chi2) << ", ";
+        os << "\"factor_nonzeros\": " << s.factor_nonzeros << ", ";
+        os << "\"factor_flops\": " << JsonNumber(s.factor_flops) << ", ";
+        os << "\"allocated_bytes\": " << s.allocated_bytes << ", ";
+        os << "\"mallocs\": " << r.mallocs << ", ";
+        os << "\"peak_rss_kb\": " << r.peak_rss_kb << "}";
+    }
+    os << "\n  ]\n}\n";
+}
+
+/// "1,2,4" -> {1, 2, 4}
+std::vector<int> ParseList(const std::string &text)
+{
+    std::vector<int> values;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ','))
+        if (!item.empty())
+            values.push_back(std::max(1, atoi(item.c_str())));
+    return values;
+}
+
+int main(int argc, char **argv)
+{
+    std::string json_path;
+    long max_edges = 1000000;
+    int iterations = 10;
+    bool quick = false;
+    int hardware = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<int> thread_counts{1};
+    if (hardware > 1)
+        thread_counts.push_back(hardware);
+
+    for (int k = 1; k < argc; ++k)
+    {
+        std::string arg = argv[k];
+        if (arg == "--json" && k + 1 < argc) json_path = argv[++k];
+        else if (arg == "--max-edges" && k + 1 < argc) max_edges = atol(argv[++k]);
+        else if (arg == "--threads" && k + 1 < argc) thread_counts = ParseList(argv[++k]);
+        else if (arg == "--iterations" && k + 1 < argc) iterations = atoi(argv[++k]);
+        else if (arg == "--quick") quick = true;
+        else
+        {
+            std::cerr << "usage: " << argv[0]
+                      << " [--json file] [--max-edges N] [--threads 1,2,4] [--iterations N] [--quick]" << std::endl;
+            return -1;
+        }
+    }
+    if (quick)
+        max_edges = std::min(max_edges, 10000l);
+
+    // 各项按规模从小到大排列，峰值 RSS 才能对应到当前这一项
+    std::vector<Scenario> scenarios;
+    for (long edges = 1000; edges <= max_edges; edges *= 10)
+        for (bool grouped: {false, true})
+            scenarios.push_back({"curve", "edges", static_cast<double>(edges), "", 0., 3,
+                                 [edges, grouped]() {
+                                     std::unique_ptr<Problem> problem = BuildCurveFitting(edges);
+                                     problem->SetGroupedAssembly(grouped);
+                                     return problem;
+                                 },
+                                 grouped ? "grouped" : ""});
+    std::vector<int> pose_counts = quick ? std::vector<int>{400} : std::vector<int>{1000, 10000};
+    for (int poses: pose_counts)
+        for (double density: {0.02, 0.2})
+            scenarios.push_back({"posegraph", "poses", static_cast<double>(poses), "loops_per_pose", density,
+                                 3ul * poses,
+                                 [poses, density]() { return BuildPoseGraph(poses, density); }});
+    std::vector<int> camera_counts = quick ? std::vector<int>{20} : std::vector<int>{20, 100};
+    for (int cameras: camera_counts)
+        for (int observations: {3, 10})
+            scenarios.push_back({"ba", "cameras", static_cast<double>(cameras), "observations_per_point",
+                                 static_cast<double>(observations), (6ul + 3ul * kPointsPerCamera) * cameras,
+                                 [cameras, observations]() { return BuildBundleAdjustment(cameras, observations); }});
+    std::vector<int> mixed_counts = quick ? std::vector<int>{2000} : std::vector<int>{10000, 100000};
+    for (int poses: mixed_counts)
+        for (bool registered: {false, true})
+            scenarios.push_back({"mixed", "poses", static_cast<double>(poses), "", 0., 3ul * poses,
+                                 [poses, registered]() { return BuildMixedGraph(poses, registered); },
+                                 registered ? "registered" : "virtual"});
+
+    // 稠密的 H 为 n^2 个 double，太大时跳过
+    const unsigned long kMaxDenseParameters = 4000;
+    const Problem::LinearSolverType solvers[] = {Problem::LinearSolverType::DENSE,
+                                                 Problem::LinearSolverType::SPARSE,
+                                                 Problem::LinearSolverType::ITERATIVE};
+
+    std::cout << std::left << std::setw(10) << "suite" << std::setw(40) << "size" << std::setw(10) << "solver"
+              << std::right << std::setw(3) << "th" << std::setw(10) << "edges" << std::setw(12) << "edges/s"
+              << std::setw(10) << "total ms" << std::setw(10) << "lin ms" << std::setw(10) << "solve ms"
+              << std::setw(9) << "mallocs" << std::setw(10) << "rss KB" << std::setw(12) << "chi2" << std::endl;
+    std::vector<BenchmarkResult> results;
+    for (const Scenario &scenario: scenarios)
+    {
+        for (Problem::LinearSolverType solver: solvers)
+        {
+            if (solver == Problem::LinearSolverType::DENSE && scenario.parameters > kMaxDenseParameters)
+                continue;
+            for (int threads: thread_counts)
+            {
+                BenchmarkResult result = Run(scenario, solver, threads, iterations);
+                PrintRow(result);
+                results.push_back(result);
+            }
+        }
+    }
+
+    if (!json_path.empty())
+    {
+        std::ofstream file(json_path);
+        if (!file.is_open())
+        {
+            std::cerr << "cannot open " << json_path << std::endl;
+            return -1;
+        }
+        WriteJson(file, results);
+        std::cout << "results written to " << json_path << std::endl;
+    }
+    return 0;
+}
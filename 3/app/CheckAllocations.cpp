@@ -0,0 +1,138 @@
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <functional>
+#include <string>
+#include <vector>
+#include <thread>
+#include <cstdlib>
+#include "benchmark_problems.h"
+
+using namespace std;
+
+/*
+ * 检查 LM 的迭代在第一次求解之后不再分配内存: 线性化、加阻尼、解线性方程、更新状态、计算 chi2 以及回滚
+ * 用到的 H、b、分解、各线程的缓存和边的雅可比都应该复用
+ * 覆盖定长边、动态大小的边、自动求导的边和 SLAM 问题，DENSE / SPARSE / ITERATIVE / Schur 补几种求解方式，
+ * 逐条边和分组装配，以及单线程和多线程
+ *
+ * 统计相邻两次迭代回调之间 malloc 的次数，这一段正好是一次完整的迭代:
+ * 上一步被接受时在新的线性化点上构造 H，然后解线性方程、更新状态、计算 chi2，被拒绝时回滚
+ * 每一项从同一个初值重复求解若干次，第一次求解构造稀疏结构、排序和各种缓存，允许分配内存，不检查
+ *
+ * 只在 glibc 下统计 malloc，其他平台直接跳过；有分配时返回 1
+ *
+ * 用法: ./checkAllocations [重复次数]
+ */
+
+// ---------------------------------------------------------------- 检查
+struct Check
+{
+    std::string name;
+    Problem::LinearSolverType solver;
+    bool grouped;
+    std::function<std::unique_ptr<Problem>()> build;
+};
+
+struct CheckResult
+{
+    int iterations = 0;         // 检查了的迭代次数
+    int linearizations = 0;     // 其中包含重新线性化的次数 (上一步被接受)
+    long max_mallocs = 0;       // 单次迭代中 malloc 次数的最大值
+};
+
+CheckResult RunCheck(const Check &check, int threads, int repeats)
+{
+    std::unique_ptr<Problem> problem = check.build();
+    problem->SetLinearSolverType(check.solver);
+    problem->SetGroupedAssembly(check.grouped);
+    problem->SetNumThreads(threads);
+
+    CheckResult result;
+    bool checking = false;
+    long last_count = -1;
+    bool last_accepted = false;
+    SolveOptions options;
+    options.max_iterations = 20;
+    options.callback = [&](const IterationSummary &step) {
+        long count = MallocCount();
+        if (checking && last_count >= 0)
+        {
+            ++result.iterations;
+            result.linearizations += last_accepted ? 1 : 0;
+            result.max_mallocs = std::max(result.max_mallocs, count - last_count);
+        }
+        last_accepted = step.accepted;
+        last_count = count;
+        return true;
+    };
+
+    // 稀疏分解第一次 Solve 时会重排状态向量，所以先求解 0 次迭代，在最终的布局下保存初值
+    problem->Solve(0);
+    const VecX initial = problem->State();
+    for (int k = 0; k <= repeats; ++k)
+    {
+        problem->SetState(initial);
+        checking = k > 0;
+        last_count = -1;
+        problem->Solve(options);
+    }
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    int repeats = argc > 1 ? std::max(1, atoi(argv[1])) : 5;
+    if (MallocCount() < 0)
+    {
+        std::cout << "malloc counting is only supported with glibc, skipped" << std::endl;
+        return 0;
+    }
+
+    typedef Problem::LinearSolverType Solver;
+    std::vector<Check> checks;
+    for (bool grouped: {false, true})
+    {
+        checks.push_back({"curve fixed-size", Solver::DENSE, grouped, []() { return BuildCurveFitting<CurveFittingEdge>(2000); }});
+        checks.push_back({"curve dynamic", Solver::DENSE, grouped,
+                          []() { return BuildCurveFitting<DynamicCurveFittingEdge>(2000); }});
+        for (Solver solver: {Solver::DENSE, Solver::SPARSE, Solver::ITERATIVE})
+            checks.push_back({"posegraph autodiff", solver, grouped, []() { return BuildPoseGraph(300, 0.2); }});
+    }
+    checks.push_back({"ba slam (schur)", Solver::AUTO, false, []() { return BuildBundleAdjustment(20, 3); }});
+
+    std::vector<int> thread_counts{1};
+    int hardware = std::max(2u, std::thread::hardware_concurrency());
+    thread_counts.push_back(hardware);
+
+    auto SolverName = [](Solver solver) {
+        switch (solver)
+        {
+            case Solver::DENSE: return "dense";
+            case Solver::SPARSE: return "sparse";
+            case Solver::ITERATIVE: return "iterative";
+            default: return "auto";
+        }
+    };
+
+    int failures = 0;
+    std::cout << std::left << std::setw(22) << "problem" << std::setw(11) << "solver" << std::setw(9) << "grouped"
+              << std::setw(9) << "threads" << std::setw(12) << "iterations" << std::setw(16) << "linearizations"
+              << "mallocs" << std::endl;
+    for (const Check &check: checks)
+    {
+        for (int threads: thread_counts)
+        {
+            CheckResult result = RunCheck(check, threads, repeats);
+            bool ok = result.linearizations > 0 && result.max_mallocs == 0;
+            failures += ok ? 0 : 1;
+            std::cout << std::left << std::setw(22) << check.name << std::setw(11) << SolverName(check.solver)
+                      << std::setw(9) << (check.grouped ? "yes" : "no") << std::setw(9) << threads
+                      << std::setw(12) << result.iterations << std::setw(16) << result.linearizations
+                      << result.max_mallocs
+                      << (ok ? "" : "  FAILED") << std::endl;
+        }
+    }
+    std::cout << (failures == 0 ? "all checks passed" : std::to_string(failures) + " checks FAILED") << std::endl;
+    return failures == 0 ? 0 : 1;
+}
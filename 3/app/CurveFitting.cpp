@@ -60,6 +60,7 @@ int main()
 
     // 构建 problem
     Problem problem(Problem::ProblemType::GENERIC_PROBLEM);
+    problem.SetVerbose(true);
     shared_ptr< CurveFittingVertex > vertex(new CurveFittingVertex());
 
     // 设定待估计参数 a, b, c初始值
@@ -0,0 +1,176 @@
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <cstdlib>
+#include "backend/problem.h"
+#include "backend/base_fixed_vertex.h"
+#include "backend/base_fixed_edge.h"
+#include "backend/normal_equation_accumulator.h"
+#include "utils/tic_toc.h"
+
+using namespace myslam::backend;
+using namespace std;
+
+/*
+ * 流式曲线拟合 y = a*x^2 + b*x + c
+ * 模型对 abc 是线性的，观测不需要保存成边，直接累加到 3x3 的正规方程中，内存与观测数量无关
+ *   1. 小规模数据上与 Problem + 每个观测一条边的结果对比
+ *   2. 多个线程各自累加，Merge 后求解；再经过 Save / Load 模拟不同文件的合并
+ *
+ * 用法: ./streamCurveFitting [观测数量] [线程数]
+ */
+
+typedef NormalEquationAccumulator<3> Accumulator;
+
+/// 特征 phi(x) = [x^2, x, 1]
+struct QuadraticFeature
+{
+    template <typename Phi>
+    void operator()(double x, Phi &phi) const
+    {
+        phi << x * x, x, 1.;
+    }
+};
+
+class CurveFittingVertex: public BaseFixedVertex<3>
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+class CurveFittingEdge: public BaseFixedEdge<1, 3>
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    CurveFittingEdge( double x, double y ): BaseFixedEdge<1, 3>(std::vector<std::string>{"abc"}), x_(x), y_(y) {}
+
+    virtual void ComputeResidual() override
+    {
+        Eigen::Map<const Vec3> abc(verticies_[0]->Parameters().data());
+        FixedResidual()(0) = abc(0)*x_*x_ + abc(1)*x_ + abc(2) - y_;
+    }
+
+    virtual void ComputeJacobians() override
+    {
+        Jacobian<0>() << x_ * x_ , x_  , 1 ;
+    }
+
+    double x_,y_;
+};
+
+/// 第 k 个观测，x 在 [0, 1) 上均匀分布
+void Sample(uint64_t k, uint64_t N, std::default_random_engine &generator, std::normal_distribution<double> &noise,
+            double &x, double &y)
+{
+    x = static_cast<double>(k) / N;
+    y = x*x + 2.*x + 1. + noise(generator);
+}
+
+/// 观测 [begin, end) 流式加入累加器，每次只生成一小块
+void Accumulate(uint64_t begin, uint64_t end, uint64_t N, unsigned seed, Accumulator &accumulator)
+{
+    std::default_random_engine generator(seed);
+    std::normal_distribution<double> noise(0., 1.);
+    const int kBlock = 4096;
+    double xs[kBlock], ys[kBlock];
+    for (uint64_t k = begin; k < end; k += kBlock)
+    {
+        int size = static_cast<int>(std::min<uint64_t>(kBlock, end - k));
+        for (int i = 0; i < size; ++i)
+            Sample(k + i, N, generator, noise, xs[i], ys[i]);
+        accumulator.AddSamples(xs, ys, size, QuadraticFeature());
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t N = argc > 1 ? strtoull(argv[1], nullptr, 10) : 100000000ull;
+    int num_threads = argc > 2 ? atoi(argv[2]) : std::max(1u, std::thread::hardware_concurrency());
+
+    // 1. 小规模数据上与逐条边的 Problem 对比
+    {
+        const uint64_t n = 10000;
+        Problem problem(Problem::ProblemType::GENERIC_PROBLEM);
+        shared_ptr<CurveFittingVertex> vertex = problem.NewVertex<CurveFittingVertex>();
+        vertex->SetParameters(Eigen::Vector3d (0.,0.,0.));
+        problem.AddVertex(vertex);
+
+        Accumulator accumulator;
+        std::default_random_engine generator;
+        std::normal_distribution<double> noise(0., 1.);
+        for (uint64_t k = 0; k < n; ++k)
+        {
+            double x, y;
+            Sample(k, n, generator, noise, x, y);
+            shared_ptr<CurveFittingEdge> edge = problem.NewEdge<CurveFittingEdge>(x, y);
+            edge->SetVertex(std::vector<std::shared_ptr<Vertex>>{vertex});
+            problem.AddEdge(edge);
+            accumulator.Add(Vec3(x * x, x, 1.), y);
+        }
+        problem.Solve(10);
+
+        Vec3 abc;
+        accumulator.Solve(abc);
+        std::cout << "-------" << n << " observations" << std::endl;
+        std::cout << "Problem + edges    : abc = " << vertex->Parameters().transpose()
+                  << ", chi2 = " << problem.Summary().final_chi2 << std::endl;
+        std::cout << "accumulator        : abc = " << abc.transpose() << ", chi2 = " << accumulator.Chi2(abc) << std::endl;
+
+        // 累加好的正规方程作为一条边放进 Problem
+        Problem compact(Problem::ProblemType::GENERIC_PROBLEM);
+        shared_ptr<CurveFittingVertex> compact_vertex = compact.NewVertex<CurveFittingVertex>();
+        compact_vertex->SetParameters(Eigen::Vector3d (0.,0.,0.));
+        compact.AddVertex(compact_vertex);
+        shared_ptr<NormalEquationEdge<3>> edge = compact.NewEdge<NormalEquationEdge<3>>(accumulator);
+        edge->SetVertex(std::vector<std::shared_ptr<Vertex>>{compact_vertex});
+        compact.AddEdge(edge);
+        compact.Solve(10);
+        std::cout << "NormalEquationEdge : abc = " << compact_vertex->Parameters().transpose() << std::endl;
+    }
+
+    // 2. 多线程累加后合并
+    {
+        TicToc t_accumulate;
+        std::vector<Accumulator, Eigen::aligned_allocator<Accumulator>> partial(num_threads);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < num_threads; ++t)
+        {
+            threads.emplace_back([&partial, N, t, num_threads]() {
+                Accumulate(N * t / num_threads, N * (t + 1) / num_threads, N, t + 1, partial[t]);
+            });
+        }
+        for (auto &thread: threads)
+            thread.join();
+        double accumulate_cost = t_accumulate.toc();
+
+        // 每个线程的结果写成一个 "文件"，读回后合并
+        Accumulator total;
+        for (int t = 0; t < num_threads; ++t)
+        {
+            std::stringstream file;
+            partial[t].Save(file);
+            Accumulator loaded;
+            if (!loaded.Load(file))
+            {
+                std::cerr << "failed to load accumulator " << t << std::endl;
+                return -1;
+            }
+            total.Merge(loaded);
+        }
+
+        Vec3 abc;
+        if (!total.Solve(abc))
+        {
+            std::cerr << "normal equation is not positive definite" << std::endl;
+            return -1;
+        }
+        std::cout << "-------" << total.Count() << " observations, " << num_threads << " threads, "
+                  << sizeof(Accumulator) << " bytes per accumulator" << std::endl;
+        std::cout << "accumulate: " << accumulate_cost << " ms (" << accumulate_cost * 1e6 / N << " ns per observation)"
+                  << std::endl;
+        std::cout << "abc = " << abc.transpose() << ", chi2 / N = " << total.Chi2(abc) / N << std::endl;
+        std::cout << "-------ground truth: 1.0,  2.0,  1.0" << std::endl;
+    }
+    return 0;
+}
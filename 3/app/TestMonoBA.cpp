@@ -0,0 +1,195 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <map>
+#include <tuple>
+#include "backend/problem.h"
+#include "backend/vertex_pose.h"
+#include "backend/vertex_point_xyz.h"
+#include "backend/edge_reprojection.h"
+#include "utils/tic_toc.h"
+
+using namespace myslam::backend;
+using namespace std;
+
+/*
+ * Frame : 保存每帧的姿态和观测
+ */
+struct Frame
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    Frame(Eigen::Matrix3d R, Eigen::Vector3d t) : Rwc(R), qwc(R), twc(t) {};
+    Eigen::Matrix3d Rwc;
+    Eigen::Quaterniond qwc;
+    Eigen::Vector3d twc;
+
+    std::map<int, Eigen::Vector2d, std::less<int>,
+             Eigen::aligned_allocator<std::pair<const int, Eigen::Vector2d>>> featurePerId; // 该帧观测到的特征以及特征id
+};
+typedef std::vector<Frame, Eigen::aligned_allocator<Frame>> VecFrame;
+
+/*
+ * 产生世界坐标系下的虚拟数据: 相机姿态, 特征点, 以及每帧观测
+ */
+void GetSimDataInWordFrame(VecFrame &cameraPoses, VecVec3 &points)
+{
+    int featureNums = 300;  // 特征数目，假设每帧都能观测到所有的特征
+    int poseNums = 20;      // 相机数目
+
+    double radius = 8;
+    for (int n = 0; n < poseNums; ++n)
+    {
+        double theta = n * 2 * M_PI / (poseNums * 4); // 1/4 圆弧
+        // 绕 z轴 旋转
+        Eigen::Matrix3d R;
+        R = Eigen::AngleAxisd(theta, Eigen::Vector3d::UnitZ());
+        Eigen::Vector3d t = Eigen::Vector3d(radius * cos(theta) - radius, radius * sin(theta), 1 * sin(2 * theta));
+        cameraPoses.push_back(Frame(R, t));
+    }
+
+    // 随机数生成三维特征点
+    std::default_random_engine generator;
+    std::normal_distribution<double> noise_pdf(0., 1. / 1000.);  // 2pixel / focal
+    std::uniform_real_distribution<double> xy_rand(-4, 4.0);
+    std::uniform_real_distribution<double> z_rand(4., 8.);
+    for (int j = 0; j < featureNums; ++j)
+    {
+        Eigen::Vector3d Pw(xy_rand(generator), xy_rand(generator), z_rand(generator));
+        points.push_back(Pw);
+
+        // 在每一帧上的观测量
+        for (int i = 0; i < poseNums; ++i)
+        {
+            Eigen::Vector3d Pc = cameraPoses[i].Rwc.transpose() * (Pw - cameraPoses[i].twc);
+            Eigen::Vector2d obs(Pc.x() / Pc.z() + noise_pdf(generator), Pc.y() / Pc.z() + noise_pdf(generator));
+            cameraPoses[i].featurePerId.insert(make_pair(j, obs));
+        }
+    }
+}
+
+/*
+ * 读取 vio_data_simulation 生成的数据: cam_pose.txt 以及 keyframe/all_points_n.txt
+ * 每隔 step 个关键帧取一帧，最多取 maxFrames 帧
+ */
+bool LoadSimData(const string &dir, int step, int maxFrames, VecFrame &cameraPoses, VecVec3 &points)
+{
+    ifstream poseFile(dir + "/cam_pose.txt");
+    if (!poseFile.is_open())
+    {
+        cerr << "cannot open " << dir << "/cam_pose.txt" << endl;
+        return false;
+    }
+
+    // 同一个路标点在不同关键帧文件中的世界坐标相同，用坐标来关联
+    map<tuple<double, double, double>, int> pointIds;
+    string line;
+    for (int n = 0; std::getline(poseFile, line) && static_cast<int>(cameraPoses.size()) < maxFrames; ++n)
+    {
+        if (n % step != 0) continue;
+        double time, qw, qx, qy, qz, tx, ty, tz;
+        stringstream ss(line);
+        ss >> time >> qw >> qx >> qy >> qz >> tx >> ty >> tz;
+        Frame frame(Eigen::Quaterniond(qw, qx, qy, qz).normalized().toRotationMatrix(), Eigen::Vector3d(tx, ty, tz));
+
+        ifstream featureFile(dir + "/keyframe/all_points_" + to_string(n) + ".txt");
+        double x, y, z, w, u, v;
+        while (featureFile >> x >> y >> z >> w >> u >> v)
+        {
+            auto key = make_tuple(x, y, z);
+            auto it = pointIds.find(key);
+            if (it == pointIds.end())
+            {
+                it = pointIds.insert(make_pair(key, static_cast<int>(points.size()))).first;
+                points.push_back(Eigen::Vector3d(x, y, z));
+            }
+            frame.featurePerId.insert(make_pair(it->second, Eigen::Vector2d(u, v)));
+        }
+        cameraPoses.push_back(frame);
+    }
+    return cameraPoses.size() > 2;
+}
+
+int main(int argc, char **argv)
+{
+    // 准备数据, 给定 vio_data_simulation 的 bin 目录时使用仿真数据
+    VecFrame cameras;
+    VecVec3 points;
+    if (argc > 1)
+    {
+        int step = argc > 2 ? atoi(argv[2]) : 10;
+        int maxFrames = argc > 3 ? atoi(argv[3]) : 60;
+        if (!LoadSimData(argv[1], step, maxFrames, cameras, points))
+            return -1;
+    }
+    else
+    {
+        GetSimDataInWordFrame(cameras, points);
+    }
+
+    // 构建 problem, 顶点和边都在 problem 的内存池中创建
+    Problem problem(Problem::ProblemType::SLAM_PROBLEM);
+    problem.SetVerbose(true);
+    // 重投影边使用专用的计算核，不经过虚函数
+    problem.RegisterEdgeType<EdgeReprojectionXYZ>();
+
+    // 所有 Pose, 前两帧固定以消除尺度和姿态的自由度
+    std::default_random_engine generator;
+    std::normal_distribution<double> pose_noise(0., 0.05);
+    vector<shared_ptr<VertexPose>> vertexCams_vec;
+    for (size_t i = 0; i < cameras.size(); ++i)
+    {
+        shared_ptr<VertexPose> vertexCam = problem.NewVertex<VertexPose>();
+        Eigen::VectorXd pose(7);
+        Eigen::Vector3d t = cameras[i].twc;
+        if (i > 1)
+            t += Eigen::Vector3d(pose_noise(generator), pose_noise(generator), pose_noise(generator));
+        pose << t, cameras[i].qwc.x(), cameras[i].qwc.y(), cameras[i].qwc.z(), cameras[i].qwc.w();
+        vertexCam->SetParameters(pose);
+        if (i < 2)
+            vertexCam->SetFixed();
+
+        problem.AddVertex(vertexCam);
+        vertexCams_vec.push_back(vertexCam);
+    }
+
+    // 所有 Point 及 edge
+    std::normal_distribution<double> noise_pdf(0, 0.2);
+    vector<shared_ptr<VertexPointXYZ>> allPoints;
+    for (size_t k = 0; k < points.size(); ++k)
+    {
+        shared_ptr<VertexPointXYZ> verterxPoint = problem.NewVertex<VertexPointXYZ>();
+        Eigen::Vector3d noisePoint = points[k] +
+            Eigen::Vector3d(noise_pdf(generator), noise_pdf(generator), noise_pdf(generator));
+        verterxPoint->SetParameters(noisePoint);
+        problem.AddVertex(verterxPoint);
+        allPoints.push_back(verterxPoint);
+
+        for (size_t i = 0; i < cameras.size(); ++i)
+        {
+            auto it = cameras[i].featurePerId.find(static_cast<int>(k));
+            if (it == cameras[i].featurePerId.end()) continue;
+
+            shared_ptr<EdgeReprojectionXYZ> edge = problem.NewEdge<EdgeReprojectionXYZ>(it->second);
+            std::vector<std::shared_ptr<Vertex>> edge_vertex;
+            edge_vertex.push_back(verterxPoint);
+            edge_vertex.push_back(vertexCams_vec[i]);
+            edge->SetVertex(edge_vertex);
+
+            problem.AddEdge(edge);
+        }
+    }
+
+    std::cout << "\nTest MonoBA start: " << cameras.size() << " poses, " << points.size() << " points" << std::endl;
+    problem.Solve(10);
+
+    double point_err = 0, pose_err = 0;
+    for (size_t k = 0; k < allPoints.size(); ++k)
+        point_err += (allPoints[k]->Parameters() - points[k]).norm();
+    for (size_t i = 0; i < vertexCams_vec.size(); ++i)
+        pose_err += (vertexCams_vec[i]->Parameters().head<3>() - cameras[i].twc).norm();
+    std::cout << "-------After optimization, mean point error: " << point_err / allPoints.size()
+              << " , mean translation error: " << pose_err / vertexCams_vec.size() << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,264 @@
+#ifndef MYSLAM_APP_BENCHMARK_PROBLEMS_H
+#define MYSLAM_APP_BENCHMARK_PROBLEMS_H
+
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "backend/problem.h"
+#include "backend/base_fixed_vertex.h"
+#include "backend/base_fixed_edge.h"
+#include "backend/autodiff_edge.h"
+#include "backend/vertex_pose.h"
+#include "backend/vertex_point_xyz.h"
+#include "backend/edge_reprojection.h"
+
+/*
+ * benchSuite 和 checkAllocations 共用的合成问题以及 malloc 计数
+ * 每个程序只有一个源文件包含这个头文件，malloc 的替换在整个程序中只定义一次
+ */
+
+using namespace myslam::backend;
+
+#ifdef __GLIBC__
+// 统计 malloc 次数: Eigen 的动态矩阵直接调用 malloc，只重载 operator new 统计不到
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+static std::atomic<long> g_malloc_count(0);
+extern "C" void *malloc(size_t size)
+{
+    g_malloc_count.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+extern "C" void *realloc(void *ptr, size_t size)
+{
+    g_malloc_count.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+inline long MallocCount() { return g_malloc_count.load(std::memory_order_relaxed); }
+#else
+inline long MallocCount() { return -1; }
+#endif
+
+// ---------------------------------------------------------------- 曲线拟合
+class CurveFittingVertex: public BaseFixedVertex<3>
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+/// 定长的边
+class CurveFittingEdge: public BaseFixedEdge<1, 3>
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    CurveFittingEdge( double x, double y ): BaseFixedEdge<1, 3>(std::vector<std::string>{"abc"}), x_(x), y_(y) {}
+
+    virtual void ComputeResidual() override
+    {
+        Eigen::Map<const Vec3> abc(verticies_[0]->Parameters().data());
+        FixedResidual()(0) = abc(0)*x_*x_ + abc(1)*x_ + abc(2) - y_;
+    }
+
+    virtual void ComputeJacobians() override
+    {
+        Jacobian<0>() << x_ * x_ , x_  , 1 ;
+    }
+
+    double x_,y_;
+};
+
+/// 动态大小的边，与 CurveFitting.cpp 相同
+class DynamicCurveFittingEdge: public Edge
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    DynamicCurveFittingEdge( double x, double y ): Edge(1, 1, std::vector<std::string>{"abc"}), x_(x), y_(y) {}
+
+    virtual void ComputeResidual() override
+    {
+        Vec3 abc = verticies_[0]->Parameters();
+        residual_(0) = abc(0)*x_*x_ + abc(1)*x_ + abc(2) - y_;
+    }
+
+    virtual void ComputeJacobians() override
+    {
+        Eigen::Matrix<double, 1, 3> jaco_abc;
+        jaco_abc << x_ * x_ , x_  , 1 ;
+        jacobians_[0] = jaco_abc;
+    }
+
+    double x_,y_;
+};
+
+/// num_edges 个 y = x^2 + 2x + 1 加噪声的观测，EdgeType 为上面两种边之一
+template <typename EdgeType = CurveFittingEdge>
+std::unique_ptr<Problem> BuildCurveFitting(long num_edges)
+{
+    std::default_random_engine generator;
+    std::normal_distribution<double> noise(0., 1.);
+    std::unique_ptr<Problem> problem(new Problem(Problem::ProblemType::GENERIC_PROBLEM));
+    std::shared_ptr<CurveFittingVertex> vertex = problem->NewVertex<CurveFittingVertex>();
+    vertex->SetParameters(Eigen::Vector3d (0.,0.,0.));
+    problem->AddVertex(vertex);
+    for (long i = 0; i < num_edges; ++i)
+    {
+        double x = i / static_cast<double>(num_edges);
+        std::shared_ptr<EdgeType> edge = problem->NewEdge<EdgeType>(x, x*x + 2.*x + 1. + noise(generator));
+        edge->SetVertex(std::vector<std::shared_ptr<Vertex>>{vertex});
+        problem->AddEdge(edge);
+    }
+    return problem;
+}
+
+// ---------------------------------------------------------------- 2D 位姿图
+class Pose2DVertex: public BaseFixedVertex<3>
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+/// 相对位姿 (dx, dy, dtheta) 的残差，角度差归一化到 (-pi, pi]
+struct RelativePose2DResidual
+{
+    RelativePose2DResidual(const Vec3 &measurement) : measurement_(measurement) {}
+
+    template <typename T>
+    bool operator()(const T *pose_i, const T *pose_j, T *residual) const
+    {
+        using std::cos;
+        using std::sin;
+        using std::atan2;
+        T dx = pose_j[0] - pose_i[0];
+        T dy = pose_j[1] - pose_i[1];
+        T c = cos(pose_i[2]);
+        T s = sin(pose_i[2]);
+        residual[0] = c * dx + s * dy - measurement_[0];
+        residual[1] = c * dy - s * dx - measurement_[1];
+        T dtheta = pose_j[2] - pose_i[2] - measurement_[2];
+        residual[2] = atan2(sin(dtheta), cos(dtheta));
+        return true;
+    }
+
+    Vec3 measurement_;
+};
+
+typedef AutoDiffEdge<RelativePose2DResidual, 3, 3, 3> RelativePose2DEdge;
+
+/**
+ * 沿半径 20 的圆反复绕圈，每圈 200 个位姿，相邻位姿之间是里程计
+ * 每个位姿以 density 的概率与前几圈中同一位置的位姿形成回环
+ */
+inline std::unique_ptr<Problem> BuildPoseGraph(int num_poses, double density)
+{
+    const int kPosesPerLap = 200;
+    const double kRadius = 20.;
+    std::default_random_engine generator;
+    std::normal_distribution<double> noise(0., 0.01);
+    std::uniform_real_distribution<double> uniform(0., 1.);
+
+    std::vector<Vec3> truth(num_poses);
+    for (int i = 0; i < num_poses; ++i)
+    {
+        double angle = 2. * M_PI * i / kPosesPerLap;
+        truth[i] = Vec3(kRadius * cos(angle), kRadius * sin(angle), std::remainder(angle + M_PI / 2., 2. * M_PI));
+    }
+    auto Measure = [&](int i, int j) {
+        double c = cos(truth[i][2]), s = sin(truth[i][2]);
+        Vec3 d = truth[j] - truth[i];
+        return Vec3(c * d[0] + s * d[1] + noise(generator), c * d[1] - s * d[0] + noise(generator),
+                    std::remainder(d[2], 2. * M_PI) + noise(generator));
+    };
+
+    std::unique_ptr<Problem> problem(new Problem(Problem::ProblemType::GENERIC_PROBLEM));
+    std::vector<std::shared_ptr<Pose2DVertex>> poses(num_poses);
+    for (int i = 0; i < num_poses; ++i)
+    {
+        poses[i] = problem->NewVertex<Pose2DVertex>();
+        Vec3 initial = truth[i] + Vec3(10. * noise(generator), 10. * noise(generator), noise(generator));
+        poses[i]->SetParameters(i == 0 ? truth[i] : initial);
+        if (i == 0)
+            poses[i]->SetFixed();
+        problem->AddVertex(poses[i]);
+    }
+    auto Connect = [&](int i, int j) {
+        auto edge = problem->NewEdge<RelativePose2DEdge>(RelativePose2DResidual(Measure(i, j)));
+        edge->SetVertex(std::vector<std::shared_ptr<Vertex>>{poses[i], poses[j]});
+        problem->AddEdge(edge);
+    };
+    for (int i = 1; i < num_poses; ++i)
+    {
+        Connect(i - 1, i);
+        if (i >= kPosesPerLap && uniform(generator) < density)
+        {
+            int laps = 1 + static_cast<int>(uniform(generator) * (i / kPosesPerLap));
+            Connect(i - laps * kPosesPerLap, i);
+        }
+    }
+    return problem;
+}
+
+// ---------------------------------------------------------------- BA
+const int kPointsPerCamera = 20;
+
+/**
+ * 相机沿圆弧运动，路标在相机前方，每个路标被 observations 个连续的相机观测
+ * 前两个相机固定
+ */
+inline std::unique_ptr<Problem> BuildBundleAdjustment(int num_cameras, int observations)
+{
+    std::default_random_engine generator;
+    std::normal_distribution<double> pixel_noise(0., 1. / 1000.);
+    std::normal_distribution<double> pose_noise(0., 0.05);
+    std::normal_distribution<double> point_noise(0., 0.2);
+    std::uniform_real_distribution<double> xy_rand(-4., 4.);
+    std::uniform_real_distribution<double> z_rand(4., 8.);
+
+    std::unique_ptr<Problem> problem(new Problem(Problem::ProblemType::SLAM_PROBLEM));
+    std::vector<Eigen::Matrix3d> rotations;
+    std::vector<Vec3> translations;
+    std::vector<std::shared_ptr<VertexPose>> cameras;
+    for (int i = 0; i < num_cameras; ++i)
+    {
+        double theta = i * 2 * M_PI / (num_cameras * 4);
+        Eigen::Matrix3d R(Eigen::AngleAxisd(theta, Eigen::Vector3d::UnitZ()));
+        Vec3 t(8. * cos(theta) - 8., 8. * sin(theta), sin(2 * theta));
+        rotations.push_back(R);
+        translations.push_back(t);
+
+        Eigen::Quaterniond q(R);
+        Vec3 initial = i > 1 ? Vec3(t + Vec3(pose_noise(generator), pose_noise(generator), pose_noise(generator))) : t;
+        VecX pose(7);
+        pose << initial, q.x(), q.y(), q.z(), q.w();
+        std::shared_ptr<VertexPose> camera = problem->NewVertex<VertexPose>();
+        camera->SetParameters(pose);
+        if (i < 2)
+            camera->SetFixed();
+        problem->AddVertex(camera);
+        cameras.push_back(camera);
+    }
+
+    int num_points = num_cameras * kPointsPerCamera;
+    int span = std::min(observations, num_cameras);
+    for (int k = 0; k < num_points; ++k)
+    {
+        int first = (k / kPointsPerCamera) * (num_cameras - span) / num_cameras;
+        Vec3 Pw = translations[first] + Vec3(xy_rand(generator), xy_rand(generator), z_rand(generator));
+        std::shared_ptr<VertexPointXYZ> point = problem->NewVertex<VertexPointXYZ>();
+        point->SetParameters(Vec3(Pw + Vec3(point_noise(generator), point_noise(generator), point_noise(generator))));
+        problem->AddVertex(point);
+        for (int i = first; i < first + span; ++i)
+        {
+            Vec3 Pc = rotations[i].transpose() * (Pw - translations[i]);
+            Vec2 obs(Pc.x() / Pc.z() + pixel_noise(generator), Pc.y() / Pc.z() + pixel_noise(generator));
+            std::shared_ptr<EdgeReprojectionXYZ> edge = problem->NewEdge<EdgeReprojectionXYZ>(obs);
+            edge->SetVertex(std::vector<std::shared_ptr<Vertex>>{point, cameras[i]});
+            problem->AddEdge(edge);
+        }
+    }
+    return problem;
+}
+
+#endif
@@ -0,0 +1,169 @@
+#include "backend/async_solver.h"
+
+namespace myslam
+{
+    namespace backend
+    {
+
+    AsyncSolver::AsyncSolver(Problem::ProblemType problem_type, const SolveOptions &options)
+        : problem_(problem_type), options_(options), published_(0), sequence_(0)
+    {
+        readers_[0] = 0;
+        readers_[1] = 0;
+        thread_ = std::thread(&AsyncSolver::WorkerLoop, this);
+    }
+
+    AsyncSolver::~AsyncSolver()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        thread_.join();
+    }
+
+    unsigned long AsyncSolver::Post(std::function<void(Problem &)> command)
+    {
+        unsigned long ticket;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pending_.push_back(std::move(command));
+            ticket = ++posted_;
+        }
+        wake_.notify_one();
+        return ticket;
+    }
+
+    unsigned long AsyncSolver::AddVertex(std::shared_ptr<Vertex> vertex)
+    {
+        return Post([vertex](Problem &problem) { problem.AddVertex(vertex); });
+    }
+
+    unsigned long AsyncSolver::RemoveVertex(std::shared_ptr<Vertex> vertex)
+    {
+        return Post([vertex](Problem &problem) { problem.RemoveVertex(vertex); });
+    }
+
+    unsigned long AsyncSolver::AddEdge(std::shared_ptr<Edge> edge)
+    {
+        return Post([edge](Problem &problem) { problem.AddEdge(edge); });
+    }
+
+    unsigned long AsyncSolver::RemoveEdge(std::shared_ptr<Edge> edge)
+    {
+        return Post([edge](Problem &problem) { problem.RemoveEdge(edge); });
+    }
+
+    unsigned long AsyncSolver::MarginalizeFrame(std::vector<std::shared_ptr<Vertex>> margVertices)
+    {
+        auto verticies = std::make_shared<std::vector<std::shared_ptr<Vertex>>>(std::move(margVertices));
+        return Post([verticies](Problem &problem) { problem.MarginalizeFrame(*verticies); });
+    }
+
+    void AsyncSolver::SetSolveOptions(const SolveOptions &options)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        options_ = options;
+    }
+
+    void AsyncSolver::SetTimeBudget(double budget)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        budget_ = budget;
+    }
+
+    void AsyncSolver::WaitUntilApplied(unsigned long ticket)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        published_cv_.wait(lock, [&] { return applied_ >= ticket; });
+    }
+
+    bool AsyncSolver::GetParameters(unsigned long vertex_id, VecX &parameters) const
+    {
+        bool found = false;
+        Read([&](const Estimate &estimate) {
+            auto iter = estimate.parameters.find(vertex_id);
+            if (iter != estimate.parameters.end())
+            {
+                parameters = iter->second;
+                found = true;
+            }
+        });
+        return found;
+    }
+
+    void AsyncSolver::GetEstimate(Estimate &estimate) const
+    {
+        Read([&](const Estimate &latest) { estimate = latest; });
+    }
+
+    void AsyncSolver::WorkerLoop()
+    {
+        std::vector<std::function<void(Problem &)>> commands;
+        while (true)
+        {
+            SolveOptions options;
+            double budget;
+            unsigned long applied;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [this] { return stop_ || !pending_.empty(); });
+                if (stop_)
+                    return;
+                commands.swap(pending_);
+                applied = posted_;
+                options = options_;
+                budget = budget_;
+            }
+
+            for (auto &command: commands)
+                command(problem_);
+            commands.clear();
+
+            if (budget > 0.)
+                options.deadline = std::chrono::steady_clock::now() +
+                                   std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                       std::chrono::duration<double, std::milli>(budget));
+            bool success = problem_.Solve(options);
+            Publish(success, applied);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                applied_ = applied;
+            }
+            published_cv_.notify_all();
+        }
+    }
+
+    void AsyncSolver::Publish(bool success, unsigned long applied)
+    {
+        // 另一个缓冲区可能还有在上次切换之前进入的读者，等它们读完
+        int slot = 1 - published_.load();
+        while (readers_[slot].load() != 0)
+            std::this_thread::yield();
+
+        Estimate &estimate = buffers_[slot];
+        estimate.sequence = sequence_.load() + 1;
+        estimate.applied = applied;
+        estimate.success = success;
+        estimate.summary = problem_.Summary();
+
+        // 已经不在问题中的顶点 (被删除或边缘化) 从结果中去掉，其余的复用原有的内存
+        const Problem::HashVertex &verticies = problem_.Vertices();
+        for (auto iter = estimate.parameters.begin(); iter != estimate.parameters.end();)
+        {
+            if (verticies.count(iter->first))
+                ++iter;
+            else
+                iter = estimate.parameters.erase(iter);
+        }
+        for (auto &vertex: verticies)
+            estimate.parameters[vertex.first] = vertex.second->Parameters();
+
+        published_.store(slot);
+        sequence_.store(estimate.sequence);
+    }
+
+    }
+}
@@ -0,0 +1,142 @@
+#ifndef MYSLAM_BACKEND_ASYNC_SOLVER_H
+#define MYSLAM_BACKEND_ASYNC_SOLVER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "backend/eigen_types.h"
+#include "backend/problem.h"
+#include "backend/solver_summary.h"
+
+namespace myslam
+{
+    namespace backend
+    {
+
+    /**
+     * 在后台线程中反复求解一个 Problem，调用者不被阻塞
+     * Problem 只属于后台线程: 调用者对问题的修改 (增删顶点和边、边缘化、设置) 都作为命令排队，
+     * 后台线程在两次求解之间一次性执行所有排队的命令，然后求解；求解期间到来的命令留到下一轮，
+     * 所以每次求解面对的都是一个不变的问题，输入比求解快时多帧的改动会合并到一次求解中
+     *
+     * 每次求解后所有顶点的参数发布到双缓冲中，读取时不加锁，也不会等待后台线程:
+     * 后台线程总是写另一个缓冲区，写之前等还在读它的 (晚到的) 读者离开，写完后原子地切换
+     * 例如 200 Hz 的 IMU 递推每次用 GetParameters 取最新的位姿，30 Hz 的优化在后台进行
+     *
+     * 交给 AsyncSolver 的顶点和边之后只能由后台线程访问 (它们的参数是 Problem 状态向量的视图)，
+     * 调用者只把它们当作句柄使用，估计值从 GetParameters / GetEstimate 读取；
+     * 它们应该用 std::make_shared 创建，Problem::NewVertex 的内存池不是线程安全的
+     */
+    class AsyncSolver
+    {
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+
+        /// 一次求解后发布的结果
+        struct Estimate
+        {
+            unsigned long sequence = 0;     // 第几次求解，0 表示还没有结果
+            unsigned long applied = 0;      // 求解前已经执行了的命令数，Post 返回的编号不超过它的命令都已生效
+            bool success = false;
+            SolverSummary summary;
+            std::unordered_map<unsigned long, VecX> parameters;     // 顶点 id -> 参数
+        };
+
+        explicit AsyncSolver(Problem::ProblemType problem_type, const SolveOptions &options = SolveOptions());
+
+        /// 停止后台线程，正在进行的求解会做完，还没有执行的命令被丢弃
+        ~AsyncSolver();
+
+        AsyncSolver(const AsyncSolver &) = delete;
+        AsyncSolver &operator=(const AsyncSolver &) = delete;
+
+        /**
+         * 排队一条在后台线程中执行的命令，命令按提交的顺序执行，之后会有一次求解
+         * 例如设置求解方式: solver.Post([](Problem &p) { p.SetLinearSolverType(...); });
+         * @return 命令的编号，从 1 开始递增，与 Estimate::applied 比较可以知道命令是否已经反映在结果中
+         */
+        unsigned long Post(std::function<void(Problem &)> command);
+
+        unsigned long AddVertex(std::shared_ptr<Vertex> vertex);
+        unsigned long RemoveVertex(std::shared_ptr<Vertex> vertex);
+        unsigned long AddEdge(std::shared_ptr<Edge> edge);
+        unsigned long RemoveEdge(std::shared_ptr<Edge> edge);
+        unsigned long MarginalizeFrame(std::vector<std::shared_ptr<Vertex>> margVertices);
+
+        /// 之后每次求解使用的选项，回调在后台线程中调用；设置了时间预算时 deadline 被覆盖 (见 SetTimeBudget)
+        void SetSolveOptions(const SolveOptions &options);
+
+        /// 每次求解的时间预算 (ms)，> 0 时截止时间为该次求解开始后 budget ms，默认 0 即不限
+        void SetTimeBudget(double budget);
+
+        /// 阻塞直到编号为 ticket 的命令执行后的求解结果已经发布
+        void WaitUntilApplied(unsigned long ticket);
+
+        /**
+         * 从最新的结果中读取一个顶点的参数，不加锁
+         * @return 还没有结果或结果中没有该顶点时返回 false
+         */
+        bool GetParameters(unsigned long vertex_id, VecX &parameters) const;
+
+        /// 复制最新的整个结果，不加锁；estimate 原有的内存会被复用
+        void GetEstimate(Estimate &estimate) const;
+
+        /// 最新结果的求解序号，0 表示还没有结果
+        unsigned long Sequence() const { return sequence_.load(); }
+
+    private:
+        void WorkerLoop();
+
+        /// 把 problem_ 中所有顶点的参数写入另一个缓冲区并切换过去
+        void Publish(bool success, unsigned long applied);
+
+        /// 读者进入最新的缓冲区后调用 read，期间后台线程不会写这个缓冲区
+        template <typename ReadFunc>
+        void Read(ReadFunc read) const
+        {
+            while (true)
+            {
+                int slot = published_.load();
+                readers_[slot].fetch_add(1);
+                // 进入之后缓冲区仍是最新的，后台线程下一次只会写另一个，并且写之前会等读者离开
+                if (published_.load() == slot)
+                {
+                    read(buffers_[slot]);
+                    readers_[slot].fetch_sub(1);
+                    return;
+                }
+                readers_[slot].fetch_sub(1);
+            }
+        }
+
+        Problem problem_;       // 只在后台线程中访问
+        std::thread thread_;
+
+        /// 命令队列和设置，由 mutex_ 保护
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        std::condition_variable published_cv_;
+        std::vector<std::function<void(Problem &)>> pending_;
+        unsigned long posted_ = 0;
+        unsigned long applied_ = 0;         // 已经发布的结果包含了前 applied_ 条命令
+        SolveOptions options_;
+        double budget_ = 0.;
+        bool stop_ = false;
+
+        /// 双缓冲: published_ 是最新结果所在的缓冲区，readers_ 是正在读各缓冲区的读者数
+        Estimate buffers_[2];
+        std::atomic<int> published_;
+        mutable std::atomic<int> readers_[2];
+        std::atomic<unsigned long> sequence_;
+    };
+
+    }
+}
+
+#endif
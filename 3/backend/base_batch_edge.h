@@ -0,0 +1,154 @@
+#ifndef MYSLAM_BACKEND_BASE_BATCH_EDGE_H
+#define MYSLAM_BACKEND_BASE_BATCH_EDGE_H
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "backend/edge.h"
+#include "backend/vertex.h"
+
+namespace myslam
+{
+    namespace backend
+    {
+
+    /**
+     * 批量的标量残差边: N 个观测 (x_k, y_k) 都连接同一个 ParamDim 维的向量空间顶点
+     * 每个观测的残差 r_k = f(x_k; p) - y_k 为标量，信息矩阵为同一个标量权重 w
+     *
+     * 观测以 SoA 的方式存放在连续数组 x[], y[] 中，连同保存的残差 r[] 每个观测只占 24 字节，不再是一条独立的边
+     * 雅可比按块计算到栈上按列存储的缓存中，J^T J 和 J^T r 对整块观测一次算完，
+     * 最后只向 H 贡献一个 ParamDim x ParamDim 的块
+     *
+     * 子类 (CRTP) 需要实现:
+     *   double EvaluateResidual(double x, double y, const ParamType &p) const;
+     *   template <typename Row> void EvaluateJacobian(double x, const ParamType &p, Row &&J) const;
+     * 可选: 按列计算一块观测的雅可比，见 EvaluateJacobians
+     *
+     * Residual() 只有一维，保存 sqrt(sum r_k^2)；单个观测的残差保存下来，线性化时不再重新计算，雅可比不保存
+     */
+    template <typename Derived, int ParamDim>
+    class BaseBatchEdge : public Edge
+    {
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+
+        typedef Eigen::Matrix<double, ParamDim, 1> ParamType;
+        typedef Eigen::Matrix<double, ParamDim, ParamDim> HessianType;
+
+        /// 每次计算的观测数量，缓存放在栈上
+        static const int kChunkSize = 128;
+
+        explicit BaseBatchEdge(const std::vector<std::string> &verticies_types = std::vector<std::string>())
+            : Edge(1, 1, verticies_types)
+        {
+            jacobians_[0].setZero(1, ParamDim);
+            JtJ_.setZero();
+            Jtr_.setZero();
+        }
+
+        /// 添加观测
+        void AddObservation(double x, double y)
+        {
+            x_.push_back(x);
+            y_.push_back(y);
+        }
+
+        void AddObservations(const double *x, const double *y, size_t n)
+        {
+            x_.insert(x_.end(), x, x + n);
+            y_.insert(y_.end(), y, y + n);
+        }
+
+        void Reserve(size_t n)
+        {
+            x_.reserve(n);
+            y_.reserve(n);
+        }
+
+        size_t NumObservations() const { return x_.size(); }
+
+        /// 每个观测的信息 (1 / sigma^2)
+        void SetWeight(double weight) { information_(0, 0) = weight; }
+
+        virtual void ComputeResidual() override
+        {
+            const Derived &derived = static_cast<const Derived &>(*this);
+            Eigen::Map<const ParamType> p(verticies_[0]->Parameters().data());
+            const size_t num = x_.size();
+            r_.resize(num);
+            for (size_t k = 0; k < num; ++k)
+                r_[k] = derived.EvaluateResidual(x_[k], y_[k], p);
+            double sum = Eigen::Map<const VecX>(r_.data(), num).squaredNorm();
+            residual_(0) = std::sqrt(sum);
+            chi2_ = information_(0, 0) * sum;
+        }
+
+        /// 只遍历一次观测计算雅可比，J^T r 使用 ComputeResidual 在同一状态下保存的残差
+        virtual void ComputeJacobians() override
+        {
+            if (r_.size() != x_.size())
+                ComputeResidual();
+            const Derived &derived = static_cast<const Derived &>(*this);
+            Eigen::Map<const ParamType> p(verticies_[0]->Parameters().data());
+            Eigen::Matrix<double, kChunkSize, ParamDim> J;
+
+            JtJ_.setZero();
+            Jtr_.setZero();
+            const size_t num = x_.size();
+            for (size_t start = 0; start < num; start += kChunkSize)
+            {
+                const int n = static_cast<int>(std::min<size_t>(kChunkSize, num - start));
+                derived.EvaluateJacobians(x_.data() + start, n, p, J.topRows(n));
+                // J 按列存储，J^T J 的每个元素是两列连续数据的点积，逐元素计算可以沿观测方向向量化，
+                // 对 ParamDim x ParamDim 这样小的结果也比通用的矩阵乘法快
+                JtJ_.noalias() += J.topRows(n).transpose().lazyProduct(J.topRows(n));
+                Jtr_.noalias() += J.topRows(n).transpose() * Eigen::Map<const VecX>(r_.data() + start, n);
+            }
+        }
+
+        /**
+         * 一块连续的 n 个观测的雅可比，J 为 n x ParamDim 的列优先块
+         * 默认逐个观测调用 EvaluateJacobian 写入 J 的一行；子类可以定义同名函数按列计算，
+         * 每列对连续的 x[0..n) 做同样的运算，便于编译器向量化
+         */
+        template <typename Block>
+        void EvaluateJacobians(const double *x, int n, const ParamType &p, Block &&J) const
+        {
+            const Derived &derived = static_cast<const Derived &>(*this);
+            for (int k = 0; k < n; ++k)
+                derived.EvaluateJacobian(x[k], p, J.row(k));
+        }
+
+        virtual double Chi2() override { return chi2_; }
+
+        virtual bool IsFixedSize() const override { return true; }
+
+        /// 单个观测的雅可比不保存，只能由自己累加
+        virtual bool IsStackable() const override { return false; }
+
+        virtual void AddHessianBlock(int, int, HessianBlockRef H_ij) const override
+        {
+            Eigen::Map<HessianType, 0, Eigen::OuterStride<>> H(H_ij.data(), Eigen::OuterStride<>(H_ij.outerStride()));
+            H.noalias() += information_(0, 0) * JtJ_;
+        }
+
+        virtual void AddGradientBlock(int, GradientBlockRef b_i) const override
+        {
+            Eigen::Map<ParamType> b(b_i.data());
+            b.noalias() -= information_(0, 0) * Jtr_;
+        }
+
+    private:
+        std::vector<double> x_;
+        std::vector<double> y_;
+        std::vector<double> r_;     // 上一次 ComputeResidual 的 r_k
+        HessianType JtJ_;       // sum J_k^T J_k
+        ParamType Jtr_;         // sum J_k^T r_k
+        double chi2_ = 0;
+    };
+
+    }
+}
+
+#endif
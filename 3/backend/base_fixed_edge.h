@@ -0,0 +1,151 @@
+#ifndef MYSLAM_BACKEND_BASE_FIXED_EDGE_H
+#define MYSLAM_BACKEND_BASE_FIXED_EDGE_H
+
+#include <type_traits>
+#include "backend/edge.h"
+
+namespace myslam
+{
+    namespace backend
+    {
+
+    namespace internal
+    {
+        /// 取出参数包 Dims 中的第 I 个维度
+        template <int I, int... Dims>
+        struct DimAt;
+
+        template <int First, int... Rest>
+        struct DimAt<0, First, Rest...>
+        {
+            static const int value = First;
+        };
+
+        template <int I, int First, int... Rest>
+        struct DimAt<I, First, Rest...>
+        {
+            static const int value = DimAt<I - 1, Rest...>::value;
+        };
+    }
+
+    /**
+     * 残差和各顶点维度在编译期确定的边
+     * @tparam ResidualDim 残差维度
+     * @tparam VertexDims 各顶点的本地参数化维度
+     *
+     * 残差、雅可比、信息矩阵在构造时按定长分配一次，子类通过 FixedResidual() / Jacobian<I>() / FixedInformation()
+     * 以定长的 Map 读写。Residual()、Jacobians() 等动态接口仍然有效，Problem 不需要区分两种边；
+     * 只有 J_i^T J_j 和 J_i^T r (白化后) 改由这里的定长乘法计算，可以完全展开并向量化
+     *
+     * 例如曲线拟合的边: class CurveFittingEdge : public BaseFixedEdge<1, 3>
+     */
+    template <int ResidualDim, int... VertexDims>
+    class BaseFixedEdge : public Edge
+    {
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+
+        static const int NumVerticies = sizeof...(VertexDims);
+
+        typedef Eigen::Matrix<double, ResidualDim, 1> ResidualType;
+        typedef Eigen::Matrix<double, ResidualDim, ResidualDim> InformationType;
+        template <int I>
+        using JacobianType = Eigen::Matrix<double, ResidualDim, internal::DimAt<I, VertexDims...>::value>;
+
+        explicit BaseFixedEdge(const std::vector<std::string> &verticies_types = std::vector<std::string>())
+            : Edge(ResidualDim, NumVerticies, verticies_types)
+        {
+            const int dims[] = {VertexDims...};
+            for (int i = 0; i < NumVerticies; ++i)
+                jacobians_[i].setZero(ResidualDim, dims[i]);
+        }
+
+        virtual bool IsFixedSize() const override { return true; }
+
+        virtual void AddHessianBlock(int i, int j, HessianBlockRef H_ij) const override
+        {
+            DispatchI(i, j, H_ij, std::integral_constant<int, 0>());
+        }
+
+        virtual void AddGradientBlock(int i, GradientBlockRef b_i) const override
+        {
+            DispatchGradient(i, b_i, std::integral_constant<int, 0>());
+        }
+
+    protected:
+        /// 定长的残差
+        Eigen::Map<ResidualType> FixedResidual() { return Eigen::Map<ResidualType>(residual_.data()); }
+        Eigen::Map<const ResidualType> FixedResidual() const { return Eigen::Map<const ResidualType>(residual_.data()); }
+
+        /// 第 I 个顶点对应的定长雅可比
+        template <int I>
+        Eigen::Map<JacobianType<I>> Jacobian() { return Eigen::Map<JacobianType<I>>(jacobians_[I].data()); }
+
+        template <int I>
+        Eigen::Map<const JacobianType<I>> Jacobian() const
+        {
+            return Eigen::Map<const JacobianType<I>>(jacobians_[I].data());
+        }
+
+        /// 定长的信息矩阵，残差和雅可比已经白化，H 和 b 的计算不再用到它
+        Eigen::Map<const InformationType> FixedInformation() const
+        {
+            return Eigen::Map<const InformationType>(information_.data());
+        }
+
+    private:
+        /// 把运行时的 (i, j) 转换成编译期的 (I, J)
+        void DispatchI(int, int, HessianBlockRef, std::integral_constant<int, NumVerticies>) const {}
+
+        template <int I>
+        void DispatchI(int i, int j, HessianBlockRef H_ij, std::integral_constant<int, I>) const
+        {
+            if (i == I)
+                DispatchJ(j, H_ij, std::integral_constant<int, I>(), std::integral_constant<int, 0>());
+            else
+                DispatchI(i, j, H_ij, std::integral_constant<int, I + 1>());
+        }
+
+        template <int I>
+        void DispatchJ(int, HessianBlockRef, std::integral_constant<int, I>,
+                       std::integral_constant<int, NumVerticies>) const {}
+
+        template <int I, int J>
+        void DispatchJ(int j, HessianBlockRef H_ij, std::integral_constant<int, I>,
+                       std::integral_constant<int, J>) const
+        {
+            if (j == J)
+                AddHessianBlockFixed<I, J>(H_ij);
+            else
+                DispatchJ(j, H_ij, std::integral_constant<int, I>(), std::integral_constant<int, J + 1>());
+        }
+
+        void DispatchGradient(int, GradientBlockRef, std::integral_constant<int, NumVerticies>) const {}
+
+        template <int I>
+        void DispatchGradient(int i, GradientBlockRef b_i, std::integral_constant<int, I>) const
+        {
+            if (i == I)
+            {
+                typedef Eigen::Matrix<double, internal::DimAt<I, VertexDims...>::value, 1> GradientType;
+                Eigen::Map<GradientType> b(b_i.data());
+                b.noalias() -= Jacobian<I>().transpose() * FixedResidual();
+            }
+            else
+                DispatchGradient(i, b_i, std::integral_constant<int, I + 1>());
+        }
+
+        template <int I, int J>
+        void AddHessianBlockFixed(HessianBlockRef H_ij) const
+        {
+            typedef Eigen::Matrix<double, internal::DimAt<I, VertexDims...>::value,
+                                  internal::DimAt<J, VertexDims...>::value> BlockType;
+            Eigen::Map<BlockType, 0, Eigen::OuterStride<>> H(H_ij.data(), Eigen::OuterStride<>(H_ij.outerStride()));
+            H.noalias() += Jacobian<I>().transpose() * Jacobian<J>();
+        }
+    };
+
+    }
+}
+
+#endif
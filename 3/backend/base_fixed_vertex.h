@@ -0,0 +1,65 @@
+#ifndef MYSLAM_BACKEND_BASE_FIXED_VERTEX_H
+#define MYSLAM_BACKEND_BASE_FIXED_VERTEX_H
+
+#include <type_traits>
+#include "backend/vertex.h"
+
+namespace myslam
+{
+    namespace backend
+    {
+
+    /**
+     * 维度在编译期确定的顶点
+     * @tparam Dim 顶点自身维度
+     * @tparam LocalDim 本地参数化维度，默认与 Dim 相同
+     *
+     * 参数在构造时按 Dim 分配一次，之后通过定长的 Map 访问，运算可以展开和向量化
+     * 流形上的顶点 (Dim != LocalDim) 需要自己重载 Plus
+     */
+    template <int Dim, int LocalDim = Dim>
+    class BaseFixedVertex : public Vertex
+    {
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+
+        static const int FixedDimension = Dim;
+        static const int FixedLocalDimension = LocalDim;
+        typedef Eigen::Matrix<double, Dim, 1> ParameterType;
+        typedef Eigen::Matrix<double, LocalDim, 1> DeltaType;
+
+        BaseFixedVertex() : Vertex(Dim, LocalDim) {}
+
+        /// 返回定长的参数
+        Eigen::Map<const ParameterType> FixedParameters() const
+        {
+            return Eigen::Map<const ParameterType>(Parameters().data());
+        }
+
+        Eigen::Map<ParameterType> FixedParameters()
+        {
+            return Eigen::Map<ParameterType>(Parameters().data());
+        }
+
+        /// 向量空间上的顶点用定长的加法
+        virtual void Plus(const VecX &delta) override
+        {
+            PlusImpl(delta, std::integral_constant<bool, Dim == LocalDim>());
+        }
+
+    private:
+        void PlusImpl(const VecX &delta, std::true_type)
+        {
+            FixedParameters() += Eigen::Map<const DeltaType>(delta.data());
+        }
+
+        void PlusImpl(const VecX &delta, std::false_type)
+        {
+            Vertex::Plus(delta);
+        }
+    };
+
+    }
+}
+
+#endif
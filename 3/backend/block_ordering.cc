@@ -0,0 +1,261 @@
+#include <algorithm>
+#include <iterator>
+#include <set>
+#include <utility>
+#include "backend/block_ordering.h"
+
+namespace myslam
+{
+    namespace backend
+    {
+
+    namespace
+    {
+        /// 块数不超过该值的部分不再剖分
+        const int kMinDissectionSize = 64;
+
+        /// nodes 诱导的子图，结点重新从 0 编号
+        BlockGraph InducedSubgraph(const BlockGraph &graph, const std::vector<int> &nodes, std::vector<int> &local)
+        {
+            BlockGraph sub;
+            sub.weights.resize(nodes.size());
+            sub.adjacency.resize(nodes.size());
+            for (size_t k = 0; k < nodes.size(); ++k)
+                local[nodes[k]] = static_cast<int>(k);
+            for (size_t k = 0; k < nodes.size(); ++k)
+            {
+                sub.weights[k] = graph.weights[nodes[k]];
+                for (int u: graph.adjacency[nodes[k]])
+                    if (local[u] >= 0)
+                        sub.adjacency[k].push_back(local[u]);
+            }
+            for (int v: nodes)
+                local[v] = -1;
+            return sub;
+        }
+
+        /// 在 nodes 内部从 start 做 BFS，返回每个结点的层号 (不可达为 -1) 以及最后一层中的一个结点
+        int LevelStructure(const BlockGraph &graph, const std::vector<char> &in_part, int start,
+                           std::vector<int> &level, std::vector<int> &queue)
+        {
+            queue.clear();
+            queue.push_back(start);
+            level[start] = 0;
+            for (size_t head = 0; head < queue.size(); ++head)
+            {
+                int v = queue[head];
+                for (int u: graph.adjacency[v])
+                {
+                    if (in_part[u] && level[u] < 0)
+                    {
+                        level[u] = level[v] + 1;
+                        queue.push_back(u);
+                    }
+                }
+            }
+            return queue.back();
+        }
+
+        void Dissect(const BlockGraph &graph, const std::vector<int> &nodes, std::vector<char> &in_part,
+                     std::vector<int> &level, std::vector<int> &local, std::vector<int> &order)
+        {
+            if (nodes.empty())
+                return;
+            if (static_cast<int>(nodes.size()) <= kMinDissectionSize)
+            {
+                BlockGraph sub = InducedSubgraph(graph, nodes, local);
+                std::vector<int> sub_order;
+                MinimumDegreeOrdering(sub, sub_order);
+                for (int k: sub_order)
+                    order.push_back(nodes[k]);
+                return;
+            }
+
+            for (int v: nodes)
+                in_part[v] = 1;
+
+            // 伪外围点: 反复从上一次 BFS 的最远点出发，直到层数不再增加
+            std::vector<int> queue;
+            int start = nodes[0];
+            int depth = -1;
+            for (int round = 0; round < 4; ++round)
+            {
+                for (int v: nodes)
+                    level[v] = -1;
+                int last = LevelStructure(graph, in_part, start, level, queue);
+                if (level[last] <= depth)
+                    break;
+                depth = level[last];
+                start = last;
+            }
+            for (int v: nodes)
+                level[v] = -1;
+            // 4 轮之内不一定收敛，层数以最后这次 BFS 为准
+            depth = level[LevelStructure(graph, in_part, start, level, queue)];
+
+            std::vector<int> part_a, part_b, separator;
+            if (queue.size() < nodes.size())
+            {
+                // 不连通: BFS 到达的连通分量和其余部分分别处理，不需要分隔集
+                for (int v: nodes)
+                    (level[v] >= 0 ? part_a : part_b).push_back(v);
+            }
+            else
+            {
+                // 取累计权重刚过一半的那一层作为分隔集，相邻层之间才有边，所以两侧互不相连
+                long total = 0;
+                for (int v: nodes)
+                    total += graph.weights[v];
+                std::vector<long> level_weight(depth + 2, 0);
+                for (int v: nodes)
+                    level_weight[level[v]] += graph.weights[v];
+                int split = 0;
+                long accumulated = 0;
+                while (split < depth && accumulated + level_weight[split] < total / 2)
+                    accumulated += level_weight[split++];
+                if (split == 0 || split >= depth)
+                {
+                    // 层数太少 (接近完全图)，剖分没有意义
+                    for (int v: nodes)
+                        in_part[v] = 0;
+                    BlockGraph sub = InducedSubgraph(graph, nodes, local);
+                    std::vector<int> sub_order;
+                    MinimumDegreeOrdering(sub, sub_order);
+                    for (int k: sub_order)
+                        order.push_back(nodes[k]);
+                    return;
+                }
+                // 分隔层中与下一层不相连的结点并入前一侧，分隔集只保留真正需要的结点
+                for (int v: nodes)
+                {
+                    if (level[v] < split)
+                        part_a.push_back(v);
+                    else if (level[v] > split)
+                        part_b.push_back(v);
+                    else
+                    {
+                        bool touches_b = false;
+                        for (int u: graph.adjacency[v])
+                            touches_b = touches_b || (in_part[u] && level[u] == split + 1);
+                        (touches_b ? separator : part_a).push_back(v);
+                    }
+                }
+            }
+            for (int v: nodes)
+                in_part[v] = 0;
+
+            Dissect(graph, part_a, in_part, level, local, order);
+            Dissect(graph, part_b, in_part, level, local, order);
+            order.insert(order.end(), separator.begin(), separator.end());
+        }
+    }
+
+    void MinimumDegreeOrdering(const BlockGraph &graph, std::vector<int> &order)
+    {
+        int n = graph.NumNodes();
+        order.clear();
+        order.reserve(n);
+
+        // 消元图，邻接表保持有序以便合并
+        std::vector<std::vector<int>> adjacency(graph.adjacency);
+        std::vector<long> degree(n, 0);
+        std::set<std::pair<long, int>> queue;
+        for (int v = 0; v < n; ++v)
+        {
+            std::sort(adjacency[v].begin(), adjacency[v].end());
+            adjacency[v].erase(std::unique(adjacency[v].begin(), adjacency[v].end()), adjacency[v].end());
+            for (int u: adjacency[v])
+                degree[v] += graph.weights[u];
+            queue.insert(std::make_pair(degree[v], v));
+        }
+
+        std::vector<int> merged;
+        while (!queue.empty())
+        {
+            int v = queue.begin()->second;
+            queue.erase(queue.begin());
+            order.push_back(v);
+
+            // v 的邻居两两相连，并从邻居的邻接表中去掉 v
+            const std::vector<int> &clique = adjacency[v];
+            for (int u: clique)
+            {
+                merged.clear();
+                std::set_union(adjacency[u].begin(), adjacency[u].end(), clique.begin(), clique.end(),
+                               std::back_inserter(merged));
+                merged.erase(std::remove_if(merged.begin(), merged.end(),
+                                            [u, v](int x) { return x == u || x == v; }), merged.end());
+                adjacency[u].swap(merged);
+
+                queue.erase(std::make_pair(degree[u], u));
+                degree[u] = 0;
+                for (int x: adjacency[u])
+                    degree[u] += graph.weights[x];
+                queue.insert(std::make_pair(degree[u], u));
+            }
+            std::vector<int>().swap(adjacency[v]);
+        }
+    }
+
+    void NestedDissectionOrdering(const BlockGraph &graph, std::vector<int> &order)
+    {
+        int n = graph.NumNodes();
+        order.clear();
+        order.reserve(n);
+        std::vector<int> nodes(n);
+        for (int v = 0; v < n; ++v)
+            nodes[v] = v;
+        std::vector<char> in_part(n, 0);
+        std::vector<int> level(n, -1);
+        std::vector<int> local(n, -1);
+        Dissect(graph, nodes, in_part, level, local, order);
+    }
+
+    void SymbolicFactorization(const BlockGraph &graph, const std::vector<int> &order,
+                               long &nonzeros, double &flops)
+    {
+        int n = graph.NumNodes();
+        std::vector<int> position(n);
+        for (int k = 0; k < n; ++k)
+            position[order[k]] = k;
+
+        // L 第 j 个块列在对角块以下的非零块 = H 中的非零块 ∪ 消元树中各子结点的非零块 (去掉 j 本身)
+        std::vector<std::vector<int>> structure(n);
+        std::vector<std::vector<int>> children(n);
+        std::vector<int> merged;
+        nonzeros = 0;
+        flops = 0.;
+        for (int j = 0; j < n; ++j)
+        {
+            std::vector<int> &rows = structure[j];
+            for (int u: graph.adjacency[order[j]])
+                if (position[u] > j)
+                    rows.push_back(position[u]);
+            std::sort(rows.begin(), rows.end());
+            rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+            for (int c: children[j])
+            {
+                merged.clear();
+                auto begin = std::upper_bound(structure[c].begin(), structure[c].end(), j);
+                std::set_union(rows.begin(), rows.end(), begin, structure[c].end(), std::back_inserter(merged));
+                rows.swap(merged);
+                std::vector<int>().swap(structure[c]);
+            }
+            if (!rows.empty())
+                children[rows.front()].push_back(j);
+
+            long below = 0;
+            for (int r: rows)
+                below += graph.weights[order[r]];
+            long dim = graph.weights[order[j]];
+            nonzeros += dim * (dim + 1) / 2 + dim * below;
+            for (long k = 0; k < dim; ++k)
+            {
+                double count = static_cast<double>(dim - k + below);
+                flops += count * count;
+            }
+        }
+    }
+
+    }
+}
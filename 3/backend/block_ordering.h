@@ -0,0 +1,47 @@
+#ifndef MYSLAM_BACKEND_BLOCK_ORDERING_H
+#define MYSLAM_BACKEND_BLOCK_ORDERING_H
+
+#include <vector>
+
+namespace myslam
+{
+    namespace backend
+    {
+
+    /**
+     * 块级的图: 每个顶点是一个块，权重为块的维度；有非零块 H_ij 的两个顶点之间有边
+     * 排序都在块上进行，块内的标量保持相邻，稀疏分解的因子仍然由稠密的小块组成
+     */
+    struct BlockGraph
+    {
+        std::vector<std::vector<int>> adjacency;    // 不含自身，不要求有序
+        std::vector<int> weights;
+
+        int NumNodes() const { return static_cast<int>(weights.size()); }
+    };
+
+    /**
+     * 最小度排序: 每次消去带权度数 (相邻块的维度之和) 最小的块，相邻块补成团
+     * 度数相同时先消去编号小的块，结果只由图决定
+     * @param order 消元顺序，order[k] 为第 k 个消去的块
+     */
+    void MinimumDegreeOrdering(const BlockGraph &graph, std::vector<int> &order);
+
+    /**
+     * 嵌套剖分: 从伪外围点做 BFS 分层，取权重居中的一层作为分隔集，两侧递归，分隔集最后消去
+     * 块数较少的部分改用最小度排序
+     */
+    void NestedDissectionOrdering(const BlockGraph &graph, std::vector<int> &order);
+
+    /**
+     * 按 order 消元时块 Cholesky 因子 L 的规模 (按标量计)
+     * @param nonzeros L 下三角 (含对角线) 的非零元个数
+     * @param flops 分解的浮点运算次数，按 sum_j c_j^2 估计，c_j 为 L 第 j 列的非零元个数
+     */
+    void SymbolicFactorization(const BlockGraph &graph, const std::vector<int> &order,
+                               long &nonzeros, double &flops);
+
+    }
+}
+
+#endif
@@ -0,0 +1,165 @@
+#include <algorithm>
+#include <cassert>
+#include "backend/block_sparse_matrix.h"
+
+namespace myslam
+{
+    namespace backend
+    {
+
+    void BlockSparseMatrix::SetStructure(const std::vector<int> &block_dims,
+                                         std::vector<std::pair<int, int>> lower_blocks)
+    {
+        int num_blocks = static_cast<int>(block_dims.size());
+        block_dims_ = block_dims;
+        block_offsets_.resize(num_blocks);
+        rows_ = 0;
+        for (int i = 0; i < num_blocks; ++i) {
+            block_offsets_[i] = rows_;
+            rows_ += block_dims_[i];
+        }
+        scalar_to_block_.resize(rows_);
+        for (int i = 0; i < num_blocks; ++i) {
+            std::fill(scalar_to_block_.begin() + block_offsets_[i],
+                      scalar_to_block_.begin() + block_offsets_[i] + block_dims_[i], i);
+        }
+
+        // 对角块总是存在，上三角的块统一换到下三角
+        for (int i = 0; i < num_blocks; ++i) {
+            lower_blocks.emplace_back(i, i);
+        }
+        for (auto &rc: lower_blocks) {
+            if (rc.first < rc.second) std::swap(rc.first, rc.second);
+        }
+        // 按 (块列, 块行) 排序去重
+        std::sort(lower_blocks.begin(), lower_blocks.end(),
+                  [](const std::pair<int, int> &a, const std::pair<int, int> &b) {
+                      return a.second != b.second ? a.second < b.second : a.first < b.first;
+                  });
+        lower_blocks.erase(std::unique(lower_blocks.begin(), lower_blocks.end()), lower_blocks.end());
+
+        col_ptr_.assign(num_blocks + 1, 0);
+        row_blocks_.resize(lower_blocks.size());
+        for (size_t k = 0; k < lower_blocks.size(); ++k) {
+            row_blocks_[k] = lower_blocks[k].first;
+            col_ptr_[lower_blocks[k].second + 1]++;
+        }
+        for (int j = 0; j < num_blocks; ++j) {
+            col_ptr_[j + 1] += col_ptr_[j];
+        }
+
+        col_stride_.assign(num_blocks, 0);
+        for (int j = 0; j < num_blocks; ++j) {
+            for (int k = col_ptr_[j]; k < col_ptr_[j + 1]; ++k) {
+                col_stride_[j] += block_dims_[row_blocks_[k]];
+            }
+        }
+
+        long nnz = 0;
+        for (int j = 0; j < num_blocks; ++j) {
+            nnz += static_cast<long>(block_dims_[j]) * col_stride_[j];
+        }
+
+        matrix_.resize(rows_, rows_);
+        matrix_.resizeNonZeros(nnz);
+        int *outer = matrix_.outerIndexPtr();
+        int *inner = matrix_.innerIndexPtr();
+
+        slot_value_offset_.resize(row_blocks_.size());
+        int value_start = 0;
+        for (int j = 0; j < num_blocks; ++j) {
+            int row_in_col = 0;
+            for (int k = col_ptr_[j]; k < col_ptr_[j + 1]; ++k) {
+                slot_value_offset_[k] = value_start + row_in_col;
+                row_in_col += block_dims_[row_blocks_[k]];
+            }
+            for (int c = 0; c < block_dims_[j]; ++c) {
+                outer[block_offsets_[j] + c] = value_start;
+                int pos = value_start;
+                for (int k = col_ptr_[j]; k < col_ptr_[j + 1]; ++k) {
+                    int rb = row_blocks_[k];
+                    for (int r = 0; r < block_dims_[rb]; ++r) {
+                        inner[pos++] = block_offsets_[rb] + r;
+                    }
+                }
+                value_start += col_stride_[j];
+            }
+        }
+        outer[rows_] = value_start;
+        assert(value_start == nnz);
+
+        diagonal_index_.resize(rows_);
+        for (int j = 0; j < num_blocks; ++j) {
+            int slot = FindSlot(j, j);
+            for (int c = 0; c < block_dims_[j]; ++c) {
+                diagonal_index_[block_offsets_[j] + c] = slot_value_offset_[slot] + c * col_stride_[j] + c;
+            }
+        }
+
+        SetZero();
+    }
+
+    void BlockSparseMatrix::SetZero()
+    {
+        std::fill(matrix_.valuePtr(), matrix_.valuePtr() + matrix_.nonZeros(), 0.);
+    }
+
+    int BlockSparseMatrix::FindSlot(int row_block, int col_block) const
+    {
+        auto begin = row_blocks_.begin() + col_ptr_[col_block];
+        auto end = row_blocks_.begin() + col_ptr_[col_block + 1];
+        auto it = std::lower_bound(begin, end, row_block);
+        if (it == end || *it != row_block) return -1;
+        return static_cast<int>(it - row_blocks_.begin());
+    }
+
+    bool BlockSparseMatrix::HasBlock(int row_block, int col_block) const
+    {
+        return FindSlot(row_block, col_block) >= 0;
+    }
+
+    BlockSparseMatrix::BlockMap BlockSparseMatrix::Block(int row_block, int col_block)
+    {
+        assert(row_block >= col_block);
+        int slot = FindSlot(row_block, col_block);
+        assert(slot >= 0 && "block is not in the structure");
+        return SlotBlock(slot, col_block);
+    }
+
+    BlockSparseMatrix::BlockMap BlockSparseMatrix::Block(int row_block, int col_block, double *values) const
+    {
+        assert(row_block >= col_block);
+        int slot = FindSlot(row_block, col_block);
+        assert(slot >= 0 && "block is not in the structure");
+        return BlockMap(values + slot_value_offset_[slot],
+                        block_dims_[row_block], block_dims_[col_block],
+                        Eigen::OuterStride<>(col_stride_[col_block]));
+    }
+
+    BlockSparseMatrix::BlockMap BlockSparseMatrix::SlotBlock(int slot, int col_block)
+    {
+        assert(slot >= col_ptr_[col_block] && slot < col_ptr_[col_block + 1]);
+        return BlockMap(matrix_.valuePtr() + slot_value_offset_[slot],
+                        block_dims_[row_blocks_[slot]], block_dims_[col_block],
+                        Eigen::OuterStride<>(col_stride_[col_block]));
+    }
+
+    void BlockSparseMatrix::GetDiagonal(VecX &diagonal) const
+    {
+        diagonal.resize(rows_);
+        const double *values = matrix_.valuePtr();
+        for (int i = 0; i < rows_; ++i) {
+            diagonal[i] = values[diagonal_index_[i]];
+        }
+    }
+
+    void BlockSparseMatrix::SetDiagonal(const VecX &diagonal, double shift)
+    {
+        double *values = matrix_.valuePtr();
+        for (int i = 0; i < rows_; ++i) {
+            values[diagonal_index_[i]] = diagonal[i] + shift;
+        }
+    }
+
+    }
+}
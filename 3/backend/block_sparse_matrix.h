@@ -0,0 +1,104 @@
+#ifndef MYSLAM_BACKEND_BLOCK_SPARSE_MATRIX_H
+#define MYSLAM_BACKEND_BLOCK_SPARSE_MATRIX_H
+
+#include <vector>
+#include <utility>
+#include <Eigen/Sparse>
+
+#include "backend/eigen_types.h"
+
+namespace myslam
+{
+    namespace backend
+    {
+
+    /**
+     * 块稀疏的对称矩阵，只存储下三角的块(包含完整的对角块)
+     * 非零块的结构由顶点-边的连接关系决定，结构确定后数值直接写在 Eigen::SparseMatrix 的数组里，
+     * 每个块通过带 OuterStride 的 Map 访问，累加时不需要任何拷贝
+     *
+     * 同一个块列里每一列的非零元数量相同，所以块 (i,j) 在 CSC 数组中是一个列跨度固定的子矩阵
+     */
+    class BlockSparseMatrix
+    {
+    public:
+        typedef Eigen::SparseMatrix<double> SparseMatrix;
+        typedef Eigen::Map<MatXX, 0, Eigen::OuterStride<>> BlockMap;
+
+        BlockSparseMatrix() {}
+
+        /**
+         * 根据块结构分配存储
+         * @param block_dims 各块的维度，按 ordering 顺序排列
+         * @param lower_blocks 下三角的非零块 (row_block, col_block), row_block >= col_block
+         *                     对角块总是存在，可以不给
+         */
+        void SetStructure(const std::vector<int> &block_dims,
+                          std::vector<std::pair<int, int>> lower_blocks);
+
+        /// 所有数值清零，结构不变
+        void SetZero();
+
+        /// 返回块 (row_block, col_block)，要求 row_block >= col_block 且该块在结构中
+        BlockMap Block(int row_block, int col_block);
+
+        /// 同上，但数值存放在外部数组 values 中，values 的布局与 Values() 相同
+        /// 多线程构造 H 时每个线程各有一份 values，最后再归约
+        BlockMap Block(int row_block, int col_block, double *values) const;
+
+        /// 块 (row_block, col_block) 是否在结构中
+        bool HasBlock(int row_block, int col_block) const;
+
+        /// 由 ordering id (标量下标) 得到所在的块
+        int BlockIndex(unsigned long ordering_id) const { return scalar_to_block_[ordering_id]; }
+
+        int NumBlocks() const { return static_cast<int>(block_dims_.size()); }
+        int BlockDim(int block) const { return block_dims_[block]; }
+        int BlockOffset(int block) const { return block_offsets_[block]; }
+        int Rows() const { return rows_; }
+
+        /// 非零块数量（下三角）
+        int NumNonZeroBlocks() const { return static_cast<int>(row_blocks_.size()); }
+
+        /// 按块列遍历非零块: 块列 col_block 的非零块编号为 [ColBegin, ColEnd)
+        int ColBegin(int col_block) const { return col_ptr_[col_block]; }
+        int ColEnd(int col_block) const { return col_ptr_[col_block + 1]; }
+        int SlotRow(int slot) const { return row_blocks_[slot]; }
+        BlockMap SlotBlock(int slot, int col_block);
+
+        /// 数值数组及其长度
+        double *Values() { return matrix_.valuePtr(); }
+        long NumValues() const { return matrix_.nonZeros(); }
+
+        /// 下三角部分的标量稀疏矩阵，可以直接交给 SimplicialLDLT<.., Lower>
+        const SparseMatrix &Matrix() const { return matrix_; }
+
+        /// 对角线上的元素
+        double Diagonal(int i) const { return matrix_.valuePtr()[diagonal_index_[i]]; }
+        void GetDiagonal(VecX &diagonal) const;
+
+        /// 对角线赋值为 diagonal + shift，LM 中用保存的对角线加 lambda，避免反复加减带来的误差
+        void SetDiagonal(const VecX &diagonal, double shift = 0.);
+
+    private:
+        int FindSlot(int row_block, int col_block) const;
+
+        int rows_ = 0;
+        std::vector<int> block_dims_;
+        std::vector<int> block_offsets_;
+        std::vector<int> scalar_to_block_;
+
+        /// 按块列存储的 CSR 结构: 块列 j 的非零行块为 row_blocks_[col_ptr_[j] .. col_ptr_[j+1])
+        std::vector<int> col_ptr_;
+        std::vector<int> row_blocks_;
+        std::vector<int> slot_value_offset_;    // 每个非零块第一列第一个元素在 valuePtr 中的位置
+        std::vector<int> col_stride_;           // 每个块列中每一列的非零元数量
+        std::vector<int> diagonal_index_;       // 对角线元素在 valuePtr 中的位置
+
+        SparseMatrix matrix_;
+    };
+
+    }
+}
+
+#endif
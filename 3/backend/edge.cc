@@ -1,6 +1,9 @@
 #include "backend/vertex.h"
 #include "backend/edge.h"
 #include <iostream>
+#include <atomic>
+#include <Eigen/Cholesky>
+#include <Eigen/Eigenvalues>
 
 using namespace std;
 
@@ -9,7 +12,36 @@ namespace myslam
     namespace backend 
   {
 
-    unsigned long global_edge_id = 0;
+    std::atomic<unsigned long> global_edge_id(0);
+
+    namespace
+    {
+        /// 与顶点相同，每个线程一次取一段 id
+        const unsigned long kIdBlockSize = 1024;
+
+        unsigned long NextEdgeId()
+        {
+            thread_local unsigned long next = 0, end = 0;
+            if (next == end)
+            {
+                next = global_edge_id.fetch_add(kIdBlockSize, std::memory_order_relaxed);
+                end = next + kIdBlockSize;
+            }
+            return next++;
+        }
+
+        /// x <- S x，S 为上三角；第 r 行只用到第 r 行及以下的行，从上往下原地计算不需要临时矩阵
+        template <typename Derived>
+        void MultiplyUpperInPlace(const MatXX &S, Eigen::MatrixBase<Derived> &x)
+        {
+            for (Eigen::Index r = 0; r < S.rows(); ++r)
+            {
+                x.row(r) *= S(r, r);
+                for (Eigen::Index k = r + 1; k < S.cols(); ++k)
+                    x.row(r) += S(r, k) * x.row(k);
+            }
+        }
+    }
 
     Edge::Edge(int residual_dimension,int num_verticies,
     const std::vector<std::string> &verticies_types)
@@ -18,18 +50,110 @@ namespace myslam
         if(!verticies_types.empty())
             verticies_types_=verticies_types;
         jacobians_.resize(num_verticies);
-        id_=global_edge_id++;
+        id_=NextEdgeId();
 
         Eigen::MatrixXd information(residual_dimension,residual_dimension);
         information.setIdentity();
         information_=information;
+        information_form_ = InformationForm::ISOTROPIC;
+        sqrt_information_scale_ = 1.;
     }
 
     Edge::~Edge(){}
 
+    void Edge::SetInformation(const MatXX &information)
+    {
+        information_ = information;
+
+        const VecX diagonal = information.diagonal();
+        bool is_diagonal = (information - MatXX(diagonal.asDiagonal())).isZero(0.);
+        if (is_diagonal && (diagonal.array() == diagonal(0)).all())
+        {
+            information_form_ = InformationForm::ISOTROPIC;
+            sqrt_information_scale_ = std::sqrt(std::max(0., diagonal(0)));
+            sqrt_information_.resize(0, 0);
+        }
+        else if (is_diagonal)
+        {
+            information_form_ = InformationForm::DIAGONAL;
+            sqrt_information_ = diagonal.cwiseMax(0.).cwiseSqrt().asDiagonal();
+        }
+        else
+        {
+            information_form_ = InformationForm::DENSE;
+            Eigen::LLT<MatXX> llt(information);
+            if (llt.info() == Eigen::Success)
+            {
+                sqrt_information_ = llt.matrixU();
+                sqrt_information_upper_ = true;
+            }
+            else
+            {
+                // 半正定的信息矩阵: Omega = V L V^T, S = sqrt(L) V^T
+                Eigen::SelfAdjointEigenSolver<MatXX> eigen(information);
+                sqrt_information_ = eigen.eigenvalues().cwiseMax(0.).cwiseSqrt().asDiagonal() *
+                                    eigen.eigenvectors().transpose();
+                sqrt_information_upper_ = false;
+            }
+        }
+    }
+
+    void Edge::WhitenResidual()
+    {
+        switch (information_form_)
+        {
+            case InformationForm::ISOTROPIC:
+                if (sqrt_information_scale_ != 1.)
+                    residual_ *= sqrt_information_scale_;
+                break;
+            case InformationForm::DIAGONAL:
+                residual_.array() *= sqrt_information_.diagonal().array();
+                break;
+            case InformationForm::DENSE:
+                if (sqrt_information_upper_)
+                    MultiplyUpperInPlace(sqrt_information_, residual_);
+                else
+                    residual_ = sqrt_information_ * residual_;
+                break;
+        }
+    }
+
+    void Edge::WhitenJacobians()
+    {
+        for (auto &jacobian: jacobians_)
+        {
+            switch (information_form_)
+            {
+                case InformationForm::ISOTROPIC:
+                    if (sqrt_information_scale_ != 1.)
+                        jacobian *= sqrt_information_scale_;
+                    break;
+                case InformationForm::DIAGONAL:
+                    jacobian = sqrt_information_.diagonal().asDiagonal() * jacobian;
+                    break;
+                case InformationForm::DENSE:
+                    if (sqrt_information_upper_)
+                        MultiplyUpperInPlace(sqrt_information_, jacobian);
+                    else
+                        jacobian = sqrt_information_ * jacobian;
+                    break;
+            }
+        }
+    }
+
+    void Edge::AddHessianBlock(int i, int j, HessianBlockRef H_ij) const
+    {
+        H_ij.noalias() += jacobians_[i].transpose().lazyProduct(jacobians_[j]);
+    }
+
+    void Edge::AddGradientBlock(int i, GradientBlockRef b_i) const
+    {
+        b_i.noalias() -= jacobians_[i].transpose().lazyProduct(residual_);
+    }
+
     double Edge::Chi2()
     {
-        return residual_.transpose()*information_*residual_;
+        return residual_.squaredNorm();
     }
   }
 }
\ No newline at end of file
@@ -11,10 +11,18 @@ namespace myslam
     {
 
     class Vertex;
+
+    /// H 中的一个块，可以是稠密 H 的子块，也可以是稀疏 H 中带列跨度的块
+    typedef Eigen::Ref<MatXX, 0, Eigen::OuterStride<>> HessianBlockRef;
+    typedef Eigen::Ref<VecX> GradientBlockRef;
     
 /**
  * 边负责计算残差，残差是 预测-观测，维度在构造函数中定义
  * 代价函数是 残差*信息*残差，是一个数值，由后端求和后最小化
+ *
+ * 信息矩阵在 SetInformation 时分解为 Omega = S^T S，Problem 每次计算残差和雅可比后用 S 白化:
+ * r <- S r, J_i <- S J_i，之后 H 的块就是 J_i^T J_j，chi2 就是 |r|^2，不再乘信息矩阵
+ * 默认的单位阵以及 sigma^2 I 形式的信息矩阵只需要乘一个标量 (单位阵时什么都不做)，对角阵逐行缩放
  */
     class Edge 
     {
@@ -55,7 +63,7 @@ namespace myslam
     }
 
     /// 返回所有顶点
-    std::vector<std::shared_ptr<Vertex>> Verticies() const {
+    const std::vector<std::shared_ptr<Vertex>> &Verticies() const {
         return verticies_;
     }
 
@@ -63,24 +71,62 @@ namespace myslam
     virtual void ComputeResidual() = 0;
 
     /// 计算雅可比，由子类实现
-    /// 本后端不支持自动求导，需要实现每个子类的雅可比计算方法
+    /// 需要实现每个子类的雅可比计算方法，或者继承 AutoDiffEdge 只写残差，由自动求导得到雅可比
     virtual void ComputeJacobians() = 0;
 
      /// 返回信息矩阵
-    MatXX Information() const {
+    const MatXX &Information() const {
         return information_;
     }
 
-     /// 返回残差
-    VecX Residual() const { return residual_; }
+    /// 设置信息矩阵，同时计算白化用的 S
+    void SetInformation(const MatXX &information);
+
+    /// 信息矩阵的形式，决定白化的代价
+    enum class InformationForm
+    {
+        ISOTROPIC,      // s^2 I，S = s I
+        DIAGONAL,       // S 为对角阵
+        DENSE           // S 为 Cholesky 分解的上三角因子，半正定时为一般的方阵
+    };
+    InformationForm GetInformationForm() const { return information_form_; }
+
+    /// 返回残差，Problem 中的残差是白化后的 S r
+    const VecX &Residual() const { return residual_; }
+
+    /// 返回雅可比，Problem 中的雅可比是白化后的 S J
+    const std::vector<MatXX> &Jacobians() const { return jacobians_; }
+
+    /// r <- S r，在 ComputeResidual 之后调用一次
+    void WhitenResidual();
 
-    /// 返回雅可比
-    std::vector<MatXX> Jacobians() const { return jacobians_; }
+    /// J_i <- S J_i，在 ComputeJacobians 之后调用一次
+    void WhitenJacobians();
 
 
    int OrderingId() const { return ordering_id_; }
-    /// 计算平方误差，会乘以信息矩阵
-    double Chi2();
+
+   void SetOrderingId(int id) { ordering_id_ = id; }
+    /// 计算平方误差 r^T Omega r，残差需要已经白化
+    virtual double Chi2();
+
+    /// 残差是否已经在状态版本 epoch 下计算过
+    /// Problem 每次改变顶点状态都会增加版本号，版本号相同时不需要重新 ComputeResidual
+    bool ResidualUpToDate(unsigned long epoch) const { return residual_epoch_ == epoch; }
+    void SetResidualEpoch(unsigned long epoch) { residual_epoch_ = epoch; }
+
+    /// 是否由边自己计算对 H 和 b 的贡献 (定长边, 见 BaseFixedEdge)
+    /// 返回 false 时 Problem 直接用动态大小的 Jacobians() 计算
+    virtual bool IsFixedSize() const { return false; }
+
+    /// Residual() 和 Jacobians() 是否就是逐行白化后的残差和雅可比，分组装配时可以与连接同一组顶点的其他边堆叠
+    virtual bool IsStackable() const { return true; }
+
+    /// H_ij += J_i^T * J_j (白化后的雅可比)，i, j 为该边的第 i, j 个顶点
+    virtual void AddHessianBlock(int i, int j, HessianBlockRef H_ij) const;
+
+    /// b_i -= J_i^T * r (白化后的雅可比和残差)
+    virtual void AddGradientBlock(int i, GradientBlockRef b_i) const;
 
     protected:
            unsigned long id_;  // edge id
@@ -90,6 +136,11 @@ namespace myslam
             VecX residual_;                 // 残差
            std::vector<MatXX> jacobians_;  // 雅可比，每个雅可比维度是 residual x vertex[i]
            MatXX information_;             // 信息矩阵
+           InformationForm information_form_ = InformationForm::ISOTROPIC;
+           double sqrt_information_scale_ = 1.;    // ISOTROPIC 时的 s
+           MatXX sqrt_information_;        // DIAGONAL 时只用对角线，DENSE 时为 S
+           bool sqrt_information_upper_ = true;    // DENSE 时 S 是否为上三角
+           unsigned long residual_epoch_ = 0;  // residual_ 对应的状态版本，0 表示还没有计算过
 
     };
     }
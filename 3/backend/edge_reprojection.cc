@@ -0,0 +1,65 @@
+#include "backend/vertex.h"
+#include "backend/edge_reprojection.h"
+
+namespace myslam
+{
+    namespace backend
+    {
+
+    namespace
+    {
+        Mat33 SkewSymmetric(const Vec3 &v)
+        {
+            Mat33 m;
+            m << 0., -v(2), v(1),
+                 v(2), 0., -v(0),
+                 -v(1), v(0), 0.;
+            return m;
+        }
+    }
+
+    void EdgeReprojectionXYZ::ComputeResidual()
+    {
+        Vec3 pts_w = verticies_[0]->Parameters();
+
+        const Vertex::ParameterMap param_i = verticies_[1]->Parameters();
+        Qd Qwc(param_i[6], param_i[3], param_i[4], param_i[5]);
+        Vec3 twc = param_i.head<3>();
+
+        Vec3 pts_c = Qwc.inverse() * (pts_w - twc);
+        residual_ = (pts_c / pts_c.z()).head<2>() - obs_;
+    }
+
+    void EdgeReprojectionXYZ::ComputeJacobians()
+    {
+        Vec3 pts_w = verticies_[0]->Parameters();
+
+        const Vertex::ParameterMap param_i = verticies_[1]->Parameters();
+        Qd Qwc(param_i[6], param_i[3], param_i[4], param_i[5]);
+        Vec3 twc = param_i.head<3>();
+        Mat33 Rcw = Qwc.inverse().toRotationMatrix();
+
+        Vec3 pts_c = Rcw * (pts_w - twc);
+        double x = pts_c(0);
+        double y = pts_c(1);
+        double z = pts_c(2);
+        double z_2 = z * z;
+
+        // 归一化平面对相机系下点的导数
+        Mat23 jacobian_pts_c;
+        jacobian_pts_c << 1. / z, 0., -x / z_2,
+                          0., 1. / z, -y / z_2;
+
+        Eigen::Matrix<double, 2, 3> jacobian_pts_w = jacobian_pts_c * Rcw;
+
+        // pose 的扰动为 [dt, dtheta], Rwc <- Rwc * exp(dtheta)
+        Eigen::Matrix<double, 2, 6> jacobian_pose;
+        jacobian_pose.leftCols<3>() = -jacobian_pts_c * Rcw;
+        jacobian_pose.rightCols<3>() = jacobian_pts_c * SkewSymmetric(pts_c);
+
+        jacobians_[0] = jacobian_pts_w;
+        jacobians_[1] = jacobian_pose;
+    }
+
+    }
+}
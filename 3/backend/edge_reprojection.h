@@ -0,0 +1,40 @@
+#ifndef MYSLAM_BACKEND_EDGE_REPROJECTION_H
+#define MYSLAM_BACKEND_EDGE_REPROJECTION_H
+
+#include "backend/edge.h"
+
+namespace myslam
+{
+    namespace backend
+    {
+
+    /**
+     * 此边是视觉重投影误差，为二元边，与之相连的顶点有：
+     * 路标点的世界坐标 XYZ、观测到该路标点的 Camera 位姿 Twc
+     * verticies_[0] = VertexPointXYZ
+     * verticies_[1] = VertexPose
+     *
+     * 残差为归一化平面上的 预测 - 观测
+     */
+    class EdgeReprojectionXYZ : public Edge
+    {
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+
+        explicit EdgeReprojectionXYZ(const Vec2 &obs)
+            : Edge(2, 2, std::vector<std::string>{"VertexPointXYZ", "VertexPose"}), obs_(obs) {}
+
+        /// 计算残差
+        virtual void ComputeResidual() override;
+
+        /// 计算雅可比
+        virtual void ComputeJacobians() override;
+
+    private:
+        Vec2 obs_;  // 归一化平面上的观测
+    };
+
+    }
+}
+
+#endif
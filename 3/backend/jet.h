@@ -0,0 +1,191 @@
+#ifndef MYSLAM_BACKEND_JET_H
+#define MYSLAM_BACKEND_JET_H
+
+#include <cmath>
+#include <Eigen/Core>
+
+namespace myslam
+{
+    namespace backend
+    {
+
+    /**
+     * 前向自动求导用的对偶数 a + v * eps，eps^2 = 0
+     * a 是函数值，v 是对 N 个自变量的导数；N 在编译期确定，导数部分是定长向量，运算可以展开和向量化
+     * 一次计算同时得到函数值和全部偏导数，见 AutoDiffEdge
+     */
+    template <int N>
+    struct Jet
+    {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+
+        typedef Eigen::Matrix<double, N, 1> DerivativeType;
+
+        double a;
+        DerivativeType v;
+
+        Jet() : a(0.) { v.setZero(); }
+
+        /// 常数，导数为零
+        Jet(double value) : a(value) { v.setZero(); }
+
+        /// 第 k 个自变量，导数为单位向量
+        Jet(double value, int k) : a(value)
+        {
+            v.setZero();
+            v[k] = 1.;
+        }
+
+        Jet(double value, const DerivativeType &derivative) : a(value), v(derivative) {}
+
+        Jet &operator+=(const Jet &y) { *this = *this + y; return *this; }
+        Jet &operator-=(const Jet &y) { *this = *this - y; return *this; }
+        Jet &operator*=(const Jet &y) { *this = *this * y; return *this; }
+        Jet &operator/=(const Jet &y) { *this = *this / y; return *this; }
+        Jet &operator+=(double s) { a += s; return *this; }
+        Jet &operator-=(double s) { a -= s; return *this; }
+        Jet &operator*=(double s) { a *= s; v *= s; return *this; }
+        Jet &operator/=(double s) { return *this *= 1. / s; }
+    };
+
+    template <int N>
+    inline Jet<N> operator+(const Jet<N> &x) { return x; }
+
+    template <int N>
+    inline Jet<N> operator-(const Jet<N> &x) { return Jet<N>(-x.a, -x.v); }
+
+    template <int N>
+    inline Jet<N> operator+(const Jet<N> &x, const Jet<N> &y) { return Jet<N>(x.a + y.a, x.v + y.v); }
+
+    template <int N>
+    inline Jet<N> operator+(const Jet<N> &x, double s) { return Jet<N>(x.a + s, x.v); }
+
+    template <int N>
+    inline Jet<N> operator+(double s, const Jet<N> &x) { return Jet<N>(s + x.a, x.v); }
+
+    template <int N>
+    inline Jet<N> operator-(const Jet<N> &x, const Jet<N> &y) { return Jet<N>(x.a - y.a, x.v - y.v); }
+
+    template <int N>
+    inline Jet<N> operator-(const Jet<N> &x, double s) { return Jet<N>(x.a - s, x.v); }
+
+    template <int N>
+    inline Jet<N> operator-(double s, const Jet<N> &x) { return Jet<N>(s - x.a, -x.v); }
+
+    template <int N>
+    inline Jet<N> operator*(const Jet<N> &x, const Jet<N> &y) { return Jet<N>(x.a * y.a, y.a * x.v + x.a * y.v); }
+
+    template <int N>
+    inline Jet<N> operator*(const Jet<N> &x, double s) { return Jet<N>(x.a * s, x.v * s); }
+
+    template <int N>
+    inline Jet<N> operator*(double s, const Jet<N> &x) { return Jet<N>(s * x.a, s * x.v); }
+
+    /// (a + v) / (b + w) = a/b + (v - a/b * w) / b
+    template <int N>
+    inline Jet<N> operator/(const Jet<N> &x, const Jet<N> &y)
+    {
+        double inv = 1. / y.a;
+        double value = x.a * inv;
+        return Jet<N>(value, (x.v - value * y.v) * inv);
+    }
+
+    template <int N>
+    inline Jet<N> operator/(const Jet<N> &x, double s)
+    {
+        double inv = 1. / s;
+        return Jet<N>(x.a * inv, x.v * inv);
+    }
+
+    template <int N>
+    inline Jet<N> operator/(double s, const Jet<N> &y)
+    {
+        double inv = 1. / y.a;
+        double value = s * inv;
+        return Jet<N>(value, -value * inv * y.v);
+    }
+
+    /// 比较只看函数值，分段函数的导数取所在分支的导数
+    template <int N> inline bool operator<(const Jet<N> &x, const Jet<N> &y) { return x.a < y.a; }
+    template <int N> inline bool operator>(const Jet<N> &x, const Jet<N> &y) { return x.a > y.a; }
+    template <int N> inline bool operator<=(const Jet<N> &x, const Jet<N> &y) { return x.a <= y.a; }
+    template <int N> inline bool operator>=(const Jet<N> &x, const Jet<N> &y) { return x.a >= y.a; }
+    template <int N> inline bool operator==(const Jet<N> &x, const Jet<N> &y) { return x.a == y.a; }
+    template <int N> inline bool operator!=(const Jet<N> &x, const Jet<N> &y) { return x.a != y.a; }
+    template <int N> inline bool operator<(const Jet<N> &x, double s) { return x.a < s; }
+    template <int N> inline bool operator>(const Jet<N> &x, double s) { return x.a > s; }
+    template <int N> inline bool operator<=(const Jet<N> &x, double s) { return x.a <= s; }
+    template <int N> inline bool operator>=(const Jet<N> &x, double s) { return x.a >= s; }
+    template <int N> inline bool operator==(const Jet<N> &x, double s) { return x.a == s; }
+    template <int N> inline bool operator!=(const Jet<N> &x, double s) { return x.a != s; }
+    template <int N> inline bool operator<(double s, const Jet<N> &y) { return s < y.a; }
+    template <int N> inline bool operator>(double s, const Jet<N> &y) { return s > y.a; }
+    template <int N> inline bool operator<=(double s, const Jet<N> &y) { return s <= y.a; }
+    template <int N> inline bool operator>=(double s, const Jet<N> &y) { return s >= y.a; }
+    template <int N> inline bool operator==(double s, const Jet<N> &y) { return s == y.a; }
+    template <int N> inline bool operator!=(double s, const Jet<N> &y) { return s != y.a; }
+
+    /// 常用的初等函数，残差中写 using std::sqrt; sqrt(x) 就可以同时用于 double 和 Jet
+    template <int N>
+    inline Jet<N> abs(const Jet<N> &x) { return x.a < 0. ? -x : x; }
+
+    template <int N>
+    inline Jet<N> sqrt(const Jet<N> &x)
+    {
+        double s = std::sqrt(x.a);
+        return Jet<N>(s, x.v * (0.5 / s));
+    }
+
+    template <int N>
+    inline Jet<N> exp(const Jet<N> &x)
+    {
+        double e = std::exp(x.a);
+        return Jet<N>(e, e * x.v);
+    }
+
+    template <int N>
+    inline Jet<N> log(const Jet<N> &x) { return Jet<N>(std::log(x.a), x.v / x.a); }
+
+    template <int N>
+    inline Jet<N> sin(const Jet<N> &x) { return Jet<N>(std::sin(x.a), std::cos(x.a) * x.v); }
+
+    template <int N>
+    inline Jet<N> cos(const Jet<N> &x) { return Jet<N>(std::cos(x.a), -std::sin(x.a) * x.v); }
+
+    template <int N>
+    inline Jet<N> tan(const Jet<N> &x)
+    {
+        double t = std::tan(x.a);
+        return Jet<N>(t, (1. + t * t) * x.v);
+    }
+
+    template <int N>
+    inline Jet<N> asin(const Jet<N> &x) { return Jet<N>(std::asin(x.a), x.v / std::sqrt(1. - x.a * x.a)); }
+
+    template <int N>
+    inline Jet<N> acos(const Jet<N> &x) { return Jet<N>(std::acos(x.a), -x.v / std::sqrt(1. - x.a * x.a)); }
+
+    template <int N>
+    inline Jet<N> atan(const Jet<N> &x) { return Jet<N>(std::atan(x.a), x.v / (1. + x.a * x.a)); }
+
+    /// atan2(y, x) 的导数为 (x dy - y dx) / (x^2 + y^2)
+    template <int N>
+    inline Jet<N> atan2(const Jet<N> &y, const Jet<N> &x)
+    {
+        double inv = 1. / (x.a * x.a + y.a * y.a);
+        return Jet<N>(std::atan2(y.a, x.a), (x.a * y.v - y.a * x.v) * inv);
+    }
+
+    /// 函数值单独用 std::pow 计算: 写成 x^(p-1) * x 时 x = 0, p < 1 会得到 0 * inf = NaN
+    template <int N>
+    inline Jet<N> pow(const Jet<N> &x, double p)
+    {
+        if (p == 0.)
+            return Jet<N>(1.);
+        return Jet<N>(std::pow(x.a, p), (p * std::pow(x.a, p - 1.)) * x.v);
+    }
+
+    }
+}
+
+#endif
@@ -0,0 +1,170 @@
+#ifndef MYSLAM_BACKEND_LM_CONTROL_H
+#define MYSLAM_BACKEND_LM_CONTROL_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+
+#include "backend/solver_summary.h"
+
+namespace myslam
+{
+    namespace backend
+    {
+
+    /**
+     * Solve 的停止条件，用于有实时要求的场合
+     * 每两次尝试 (解线性方程、更新状态、计算 chi2) 之间检查，停止时顶点中总是最近一次被接受的状态，
+     * 被拒绝的尝试都已经回滚；停止的原因见 SolverSummary::stop_reason
+     */
+    struct SolveOptions
+    {
+        int max_iterations = 10;        // 被接受的步数上限
+        int max_linear_solves = 0;      // 解线性方程次数的上限 (包括被拒绝的尝试)，<= 0 时不限制
+
+        /**
+         * 截止时间，默认不限制，例如 steady_clock::now() + std::chrono::milliseconds(5)
+         * 下一次尝试 (以及被接受后的重新线性化) 预计会超过截止时间时就不再开始，
+         * 预计的用时取本次 Solve 中最慢的一次；开始时的第一次线性化不能打断
+         */
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+
+        /// 每次尝试之后调用，此时顶点已经是被接受的状态，返回 false 时停止
+        std::function<bool(const IterationSummary &)> callback;
+    };
+
+    namespace internal
+    {
+        /**
+         * Problem::Solve 和 SmallProblem::Solve 共用的 LM 控制: lambda 的初值与更新、步长的接受以及各种停止条件
+         * 线性化、解线性方程、更新状态和计算 chi2 由调用方完成，循环的结构为
+         *   lm.Start(chi2, max|H_ii|);
+         *   while (!lm.StopBeforeTrial(options, linear_solves, reason))
+         *   {
+         *       解 (H + lm.Lambda() I) dx = b，更新状态，算出新的 chi2 后 lm.TryStep(...)；无解时 lm.RejectStep()
+         *       if (lm.StopAfterTrial(options, accepted, proceed, reason)) break;
+         *       被接受时在新的状态上重新线性化
+         *   }
+         */
+        class LMControl
+        {
+        public:
+            /// 在第一个线性化点上初始化: lambda = 1e-5 * max|H_ii|，sqrt(chi2) 降到初始 chi2 的 1e-6 倍时停止
+            void Start(double chi2, double max_diagonal)
+            {
+                ni_ = 2.;
+                chi2_ = chi2;
+                stopThreshold_ = 1e-6 * chi2;
+                lambda_ = 1e-5 * max_diagonal;
+                iteration_ = 0;
+                rejections_ = 0;
+                trialCost_ = 0.;
+                linearizeCost_ = 0.;
+            }
+
+            /// 每次尝试之前检查，需要停止时返回 true 并给出原因
+            bool StopBeforeTrial(const SolveOptions &options, int linear_solves, StopReason &reason) const
+            {
+                if (iteration_ >= options.max_iterations)
+                    reason = StopReason::MAX_ITERATIONS;
+                else if (rejections_ > 10)
+                    reason = StopReason::TOO_MANY_REJECTIONS;
+                else if (options.max_linear_solves > 0 && linear_solves >= options.max_linear_solves)
+                    reason = StopReason::MAX_LINEAR_SOLVES;
+                else if (WouldOverrun(options, trialCost_))
+                    reason = StopReason::DEADLINE;
+                else
+                    return false;
+                return true;
+            }
+
+            /**
+             * 按实际下降与预测下降之比 rho 决定是否接受这一步，并更新 lambda (Nielsen)
+             * @param trial_chi2 更新后的 chi2
+             * @param predicted 预测的下降 dx^T (lambda dx + b)
+             */
+            bool TryStep(double trial_chi2, double predicted)
+            {
+                double rho = (chi2_ - trial_chi2) / (predicted + 1e-3);
+                if (rho > 0 && std::isfinite(trial_chi2))
+                {
+                    double alpha = std::min(1. - std::pow(2 * rho - 1, 3), 2. / 3.);
+                    lambda_ *= std::max(1. / 3., alpha);
+                    ni_ = 2;
+                    chi2_ = trial_chi2;
+                    return true;
+                }
+                RejectStep();
+                return false;
+            }
+
+            /// 被拒绝的尝试 (包括 H + lambda I 不正定、无法求解)，加大 lambda
+            void RejectStep()
+            {
+                lambda_ *= ni_;
+                ni_ *= 2;
+            }
+
+            /**
+             * 一次尝试和回调之后检查，需要停止时返回 true 并给出原因
+             * 返回 false 并且这一步被接受时，调用方在新的状态上重新线性化
+             */
+            bool StopAfterTrial(const SolveOptions &options, bool accepted, bool proceed, StopReason &reason)
+            {
+                if (!accepted)
+                {
+                    ++rejections_;
+                    reason = StopReason::CALLBACK;
+                    return !proceed;
+                }
+                rejections_ = 0;
+                ++iteration_;
+                if (std::sqrt(chi2_) <= stopThreshold_)
+                    reason = StopReason::SMALL_CHI2;
+                else if (!proceed)
+                    reason = StopReason::CALLBACK;
+                else if (iteration_ >= options.max_iterations)
+                    reason = StopReason::MAX_ITERATIONS;
+                else if (WouldOverrun(options, linearizeCost_ + trialCost_))
+                    reason = StopReason::DEADLINE;
+                else
+                    return false;
+                return true;
+            }
+
+            /// 记录一次尝试 / 重新线性化的用时 (ms)，截止时间按最慢的一次预估
+            void RecordTrialCost(double ms) { trialCost_ = std::max(trialCost_, ms); }
+            void RecordLinearizeCost(double ms) { linearizeCost_ = std::max(linearizeCost_, ms); }
+
+            double Lambda() const { return lambda_; }
+            /// 最近一次被接受的状态下的 chi2
+            double Chi2() const { return chi2_; }
+            /// 被接受的步数
+            int Iteration() const { return iteration_; }
+            /// 连续被拒绝的次数
+            int Rejections() const { return rejections_; }
+
+        private:
+            static bool WouldOverrun(const SolveOptions &options, double cost)
+            {
+                return options.deadline != std::chrono::steady_clock::time_point::max() &&
+                       std::chrono::steady_clock::now() + std::chrono::duration<double, std::milli>(cost) >
+                           options.deadline;
+            }
+
+            double lambda_ = 0.;
+            double ni_ = 2.;                // 连续被拒绝时 lambda 的放大倍数
+            double chi2_ = 0.;
+            double stopThreshold_ = 0.;
+            int iteration_ = 0;
+            int rejections_ = 0;
+            double trialCost_ = 0.;         // 最慢的一次尝试
+            double linearizeCost_ = 0.;     // 最慢的一次线性化
+        };
+    }
+
+    }
+}
+
+#endif
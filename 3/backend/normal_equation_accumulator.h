@@ -0,0 +1,237 @@
+#ifndef MYSLAM_BACKEND_NORMAL_EQUATION_ACCUMULATOR_H
+#define MYSLAM_BACKEND_NORMAL_EQUATION_ACCUMULATOR_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <Eigen/Cholesky>
+#include <Eigen/Eigenvalues>
+
+#include "backend/eigen_types.h"
+#include "backend/base_fixed_edge.h"
+#include "backend/vertex.h"
+
+namespace myslam
+{
+    namespace backend
+    {
+
+    /**
+     * 参数线性模型 y = phi(x)^T theta 的流式最小二乘
+     * 每个观测到来后立即累加到 A = sum w phi phi^T, b = sum w phi y 中，观测本身不保存，内存为 O(Dim^2)
+     * 例如曲线拟合 y = a*x^2 + b*x + c 中 phi(x) = [x^2, x, 1]
+     *
+     * 批量加入时先把 kChunkSize 个观测的 phi 排成 Dim x kChunkSize 的矩阵，再用一次矩阵乘法累加，
+     * 乘法在观测方向上向量化；每块先单独求和再加到总和上，样本很多时累加误差也比逐个相加小
+     *
+     * 不同线程或不同文件的累加器可以用 Merge 合并，Save / Load 以二进制读写
+     * 累加器不是线程安全的，每个线程用自己的累加器，最后合并
+     */
+    template <int Dim>
+    class NormalEquationAccumulator
+    {
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+
+        typedef Eigen::Matrix<double, Dim, 1> VectorType;
+        typedef Eigen::Matrix<double, Dim, Dim> MatrixType;
+
+        /// 批量加入时每块的观测数
+        static const int kChunkSize = 256;
+
+        NormalEquationAccumulator() { Clear(); }
+
+        void Clear()
+        {
+            A_.setZero();
+            b_.setZero();
+            yy_ = 0.;
+            count_ = 0;
+        }
+
+        /// 加入一个观测: 特征 phi, 观测 y, 权重 w (信息)
+        void Add(const VectorType &phi, double y, double w = 1.)
+        {
+            A_.template selfadjointView<Eigen::Upper>().rankUpdate(phi, w);
+            b_.noalias() += (w * y) * phi;
+            yy_ += w * y * y;
+            ++count_;
+        }
+
+        /**
+         * 批量加入观测，phi 的每一列是一个观测的特征
+         * @param weights 每个观测的权重，为空时都为 1
+         */
+        void AddBatch(const Eigen::Ref<const Eigen::Matrix<double, Dim, Eigen::Dynamic>> &phi,
+                      const Eigen::Ref<const VecX> &y,
+                      const Eigen::Ref<const VecX> &weights = VecX())
+        {
+            if (weights.size() == 0)
+            {
+                A_.template selfadjointView<Eigen::Upper>().rankUpdate(phi);
+                b_.noalias() += phi * y;
+                yy_ += y.squaredNorm();
+            }
+            else
+            {
+                weighted_.noalias() = phi * weights.asDiagonal();
+                A_.template triangularView<Eigen::Upper>() += weighted_ * phi.transpose();
+                b_.noalias() += weighted_ * y;
+                yy_ += y.cwiseProduct(weights).dot(y);
+            }
+            count_ += phi.cols();
+        }
+
+        /**
+         * 逐个样本 (x[k], y[k]) 流式加入，feature(x, phi) 把 x 映射为特征
+         * 内部按 kChunkSize 分块后调用 AddBatch，除了一块的缓存外不需要额外内存
+         */
+        template <typename FeatureFunc>
+        void AddSamples(const double *x, const double *y, size_t n, FeatureFunc feature)
+        {
+            chunkPhi_.resize(Dim, kChunkSize);
+            for (size_t begin = 0; begin < n; begin += kChunkSize)
+            {
+                int size = static_cast<int>(std::min<size_t>(kChunkSize, n - begin));
+                for (int k = 0; k < size; ++k)
+                {
+                    Eigen::Map<VectorType> phi(chunkPhi_.col(k).data());
+                    feature(x[begin + k], phi);
+                }
+                AddBatch(chunkPhi_.leftCols(size), Eigen::Map<const VecX>(y + begin, size));
+            }
+        }
+
+        /// 合并另一个累加器 (例如另一个线程或另一个文件中的观测)
+        void Merge(const NormalEquationAccumulator &other)
+        {
+            A_.template triangularView<Eigen::Upper>() += other.A_;
+            b_ += other.b_;
+            yy_ += other.yy_;
+            count_ += other.count_;
+        }
+
+        /// 对称的 A (内部只累加上三角)
+        MatrixType Information() const { return A_.template selfadjointView<Eigen::Upper>(); }
+        const VectorType &InformationVector() const { return b_; }
+        double WeightedSquaredObservations() const { return yy_; }
+        uint64_t Count() const { return count_; }
+
+        /// 解 A theta = b，A 不正定 (观测不足) 时返回 false
+        bool Solve(VectorType &theta) const
+        {
+            Eigen::LDLT<MatrixType, Eigen::Upper> ldlt(A_);
+            if (count_ < static_cast<uint64_t>(Dim) || ldlt.info() != Eigen::Success || !ldlt.isPositive())
+                return false;
+            theta = ldlt.solve(b_);
+            return true;
+        }
+
+        /// sum w (phi^T theta - y)^2，不需要原始观测
+        double Chi2(const VectorType &theta) const
+        {
+            return theta.dot(Information() * theta) - 2. * theta.dot(b_) + yy_;
+        }
+
+        /// 以二进制写入 / 读出，文件之间的合并先 Load 再 Merge
+        bool Save(std::ostream &os) const
+        {
+            int dim = Dim;
+            os.write(reinterpret_cast<const char *>(&dim), sizeof(dim));
+            os.write(reinterpret_cast<const char *>(&count_), sizeof(count_));
+            os.write(reinterpret_cast<const char *>(&yy_), sizeof(yy_));
+            os.write(reinterpret_cast<const char *>(A_.data()), sizeof(double) * Dim * Dim);
+            os.write(reinterpret_cast<const char *>(b_.data()), sizeof(double) * Dim);
+            return static_cast<bool>(os);
+        }
+
+        bool Load(std::istream &is)
+        {
+            int dim = 0;
+            is.read(reinterpret_cast<char *>(&dim), sizeof(dim));
+            if (!is || dim != Dim)
+                return false;
+            is.read(reinterpret_cast<char *>(&count_), sizeof(count_));
+            is.read(reinterpret_cast<char *>(&yy_), sizeof(yy_));
+            is.read(reinterpret_cast<char *>(A_.data()), sizeof(double) * Dim * Dim);
+            is.read(reinterpret_cast<char *>(b_.data()), sizeof(double) * Dim);
+            return static_cast<bool>(is);
+        }
+
+    private:
+        MatrixType A_;          // 只有上三角有效
+        VectorType b_;
+        double yy_;             // sum w y^2，用于计算 chi2
+        uint64_t count_;
+
+        Eigen::Matrix<double, Dim, Eigen::Dynamic> chunkPhi_;
+        Eigen::Matrix<double, Dim, Eigen::Dynamic> weighted_;
+    };
+
+    /**
+     * 把累加好的正规方程作为一条边放进 Problem，可以与其他边一起优化
+     * A = R^T R, d = R^-T b, 残差 r = [R theta - d; c]，c^2 = sum w y^2 - d^T d 为常数
+     * 则 r^T r = theta^T A theta - 2 theta^T b + sum w y^2，与逐个观测的 chi2 相同，LM 的收敛判断也就相同
+     * 观测不足时 A 不正定，改用特征值分解 A = V S V^T，R = S^1/2 V^T，d 中只保留 S > eps 的方向
+     * (b 总在 A 的值域内，chi2 仍然相同)，这些方向之外的参数由其他边或 LM 的阻尼决定
+     * 连接一个维度为 Dim 的向量空间顶点
+     */
+    template <int Dim>
+    class NormalEquationEdge : public BaseFixedEdge<Dim + 1, Dim>
+    {
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+
+        typedef typename NormalEquationAccumulator<Dim>::VectorType VectorType;
+        typedef typename NormalEquationAccumulator<Dim>::MatrixType MatrixType;
+
+        explicit NormalEquationEdge(const NormalEquationAccumulator<Dim> &accumulator,
+                                    const std::vector<std::string> &verticies_types = std::vector<std::string>())
+            : BaseFixedEdge<Dim + 1, Dim>(verticies_types)
+        {
+            const MatrixType A = accumulator.Information();
+            Eigen::LLT<MatrixType> llt(A);
+            if (accumulator.Count() >= static_cast<uint64_t>(Dim) && llt.info() == Eigen::Success)
+            {
+                R_ = llt.matrixU();
+                d_ = R_.transpose().template triangularView<Eigen::Lower>().solve(accumulator.InformationVector());
+            }
+            else
+            {
+                const double eps = 1e-8;
+                Eigen::SelfAdjointEigenSolver<MatrixType> saes(A);
+                VectorType S = (saes.eigenvalues().array() > eps).select(saes.eigenvalues().array(), 0);
+                VectorType S_inv = (saes.eigenvalues().array() > eps).select(saes.eigenvalues().array().inverse(), 0);
+                R_ = S.cwiseSqrt().asDiagonal() * saes.eigenvectors().transpose();
+                d_ = S_inv.cwiseSqrt().asDiagonal() * (saes.eigenvectors().transpose() * accumulator.InformationVector());
+            }
+            c_ = std::sqrt(std::max(0., accumulator.WeightedSquaredObservations() - d_.squaredNorm()));
+        }
+
+        virtual void ComputeResidual() override
+        {
+            Eigen::Map<const VectorType> theta(this->verticies_[0]->Parameters().data());
+            this->FixedResidual().template head<Dim>().noalias() = R_ * theta;
+            this->FixedResidual().template head<Dim>() -= d_;
+            this->FixedResidual()[Dim] = c_;
+        }
+
+        /// 雅可比就是 R；Problem 会在原地对雅可比做白化，所以每次都要重新写入
+        virtual void ComputeJacobians() override
+        {
+            this->template Jacobian<0>().template topRows<Dim>() = R_;
+            this->template Jacobian<0>().template bottomRows<1>().setZero();
+        }
+
+    private:
+        MatrixType R_;
+        VectorType d_;
+        double c_;
+    };
+
+    }
+}
+
+#endif
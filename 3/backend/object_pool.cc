@@ -0,0 +1,61 @@
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include "backend/object_pool.h"
+
+namespace myslam
+{
+    namespace backend
+    {
+
+    const size_t ObjectPool::kAlignment;
+
+    ObjectPool::~ObjectPool()
+    {
+        for (char *chunk: chunks_)
+            std::free(chunk);
+    }
+
+    void *ObjectPool::Allocate(size_t bytes)
+    {
+        bytes = RoundUp(bytes);
+
+        // 先复用同样大小的已释放对象
+        auto it = free_lists_.find(bytes);
+        if (it != free_lists_.end() && it->second)
+        {
+            FreeNode *node = it->second;
+            it->second = node->next;
+            return node;
+        }
+
+        if (cursor_ == nullptr || static_cast<size_t>(end_ - cursor_) < bytes)
+        {
+            // 新申请一块，大对象单独占一块
+            size_t size = std::max(chunk_bytes_, bytes) + kAlignment;
+            char *chunk = static_cast<char *>(std::malloc(size));
+            if (!chunk)
+                throw std::bad_alloc();
+            chunks_.push_back(chunk);
+            reserved_bytes_ += size;
+            size_t misalign = reinterpret_cast<size_t>(chunk) % kAlignment;
+            cursor_ = chunk + (misalign ? kAlignment - misalign : 0);
+            end_ = chunk + size;
+        }
+        void *p = cursor_;
+        cursor_ += bytes;
+        return p;
+    }
+
+    void ObjectPool::Deallocate(void *p, size_t bytes)
+    {
+        if (!p)
+            return;
+        FreeNode *&head = free_lists_[RoundUp(bytes)];
+        FreeNode *node = static_cast<FreeNode *>(p);
+        node->next = head;
+        head = node;
+    }
+
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef MYSLAM_BACKEND_OBJECT_POOL_H
+#define MYSLAM_BACKEND_OBJECT_POOL_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <Eigen/Core>
+
+namespace myslam
+{
+    namespace backend
+    {
+
+    /**
+     * 顶点和边的内存池
+     * 内存按大块申请，对象在块中连续存放；释放的对象按大小挂到各自的空闲链表上，
+     * 同一类型的对象大小相同，所以删除后再添加的顶点/边会复用原来的位置 (滑窗中每帧增删不会让池无限增长)
+     *
+     * 不是线程安全的，同一个池中的对象需要在同一个线程中创建和释放
+     */
+    class ObjectPool
+    {
+    public:
+        /// 所有对象都按这个字节数对齐，满足 Eigen 定长矩阵的要求
+        static const size_t kAlignment = EIGEN_MAX_ALIGN_BYTES > 16 ? EIGEN_MAX_ALIGN_BYTES : 16;
+
+        explicit ObjectPool(size_t chunk_bytes = 64 * 1024) : chunk_bytes_(chunk_bytes) {}
+        ~ObjectPool();
+
+        ObjectPool(const ObjectPool &) = delete;
+        ObjectPool &operator=(const ObjectPool &) = delete;
+
+        void *Allocate(size_t bytes);
+        void Deallocate(void *p, size_t bytes);
+
+        /// 已经向系统申请的字节数
+        size_t ReservedBytes() const { return reserved_bytes_; }
+
+    private:
+        static size_t RoundUp(size_t bytes) { return (bytes + kAlignment - 1) / kAlignment * kAlignment; }
+
+        struct FreeNode
+        {
+            FreeNode *next;
+        };
+
+        size_t chunk_bytes_;
+        size_t reserved_bytes_ = 0;
+        std::vector<char *> chunks_;        // 申请到的原始内存，析构时释放
+        char *cursor_ = nullptr;            // 当前块中下一个可用位置
+        char *end_ = nullptr;
+        std::unordered_map<size_t, FreeNode *> free_lists_;     // 按对象大小分类的空闲链表
+    };
+
+    /**
+     * 从 ObjectPool 分配的 STL 分配器，用于 std::allocate_shared
+     * 控制块和对象放在同一个池位置上；分配器持有池的 shared_ptr，所以池一直活到最后一个对象释放
+     */
+    template <typename T>
+    class PoolAllocator
+    {
+    public:
+        typedef T value_type;
+
+        explicit PoolAllocator(std::shared_ptr<ObjectPool> pool) : pool_(std::move(pool)) {}
+
+        template <typename U>
+        PoolAllocator(const PoolAllocator<U> &other) : pool_(other.Pool()) {}
+
+        T *allocate(size_t n) { return static_cast<T *>(pool_->Allocate(n * sizeof(T))); }
+        void deallocate(T *p, size_t n) { pool_->Deallocate(p, n * sizeof(T)); }
+
+        const std::shared_ptr<ObjectPool> &Pool() const { return pool_; }
+
+        template <typename U>
+        bool operator==(const PoolAllocator<U> &other) const { return pool_ == other.Pool(); }
+        template <typename U>
+        bool operator!=(const PoolAllocator<U> &other) const { return pool_ != other.Pool(); }
+
+    private:
+        std::shared_ptr<ObjectPool> pool_;
+    };
+
+    }
+}
+
+#endif
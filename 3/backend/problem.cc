@@ -1,5 +1,7 @@
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <unordered_set>
 #include <eigen3/Eigen/Dense>
 #include <glog/logging.h>
 #include "backend/problem.h"
@@ -17,12 +19,20 @@ namespace myslam
 {
     namespace backend
     {
-        Problem::Problem(ProblemType problemType):problemType_(problemType)
+        /// AUTO 模式下, 维度不超过该值的通用问题使用稠密 H
+        const ulong kMaxDenseDimension = 100;
+
+        Problem::Problem(ProblemType problemType):problemType_(problemType), pool_(std::make_shared<ObjectPool>())
         {
             verticies_marg_.clear();
         }
 
-        Problem::~Problem(){}
+        Problem::~Problem()
+        {
+            // 顶点可能比 Problem 活得更久，参数要搬回顶点自己的存储
+            for (auto &vertex: verticies_)
+                UnbindState(vertex.second.get());
+        }
 
         bool Problem::AddVertex(std::shared_ptr<Vertex> vertex)
         {   
@@ -35,6 +45,11 @@ namespace myslam
                 verticies_.insert(pair<unsigned long,shared_ptr<Vertex>>(vertex->Id(),vertex));
 
             }
+            if (problemType_ == ProblemType::SLAM_PROBLEM)
+                AddOrderingSLAM(vertex);
+            maxLocalDimension_ = std::max(maxLocalDimension_, vertex->LocalDimension());
+            orderingValid_ = false;
+            topologyChanged_ = true;
             return true;
               
         }
@@ -55,12 +70,320 @@ namespace myslam
             {
                  vertexToEdge_.insert(pair<ulong, shared_ptr<Edge>>(vertex->Id(), edge));
             }
+
+            // 边的 ordering id 就是它在 edgeList_ 中的位置，新边的 id 一般最大，直接放在最后
+            // 与前一条边类型不同时需要重新分组排序
+            int bucket = EdgeTypeBucket(typeid(*edge));
+            if (!edgeList_.empty() && (edgeListBuckets_.back() != bucket ||
+                                       (edgeList_.back() && !EdgeBefore(*edgeList_.back(), *edge))))
+                edgeListSorted_ = false;
+            edge->SetOrderingId(static_cast<int>(edgeList_.size()));
+            // 边可能来自另一个 Problem，它记下的状态版本号在这里没有意义
+            edge->SetResidualEpoch(0);
+            edgeList_.push_back(edge);
+            edgeListBuckets_.push_back(bucket);
+            edgeRunsValid_ = false;
+            maxResidualDimension_ = std::max(maxResidualDimension_, static_cast<int>(edge->Residual().rows()));
+
+            // 只有出现了新的非零块时稀疏结构才需要重建
+            const auto &verticies = edge->Verticies();
+            for (size_t i = 0; i < verticies.size(); ++i)
+                for (size_t j = i + 1; j < verticies.size(); ++j)
+                {
+                    if (blockPairCount_[VertexPair(verticies[i]->Id(), verticies[j]->Id())]++ == 0)
+                        topologyChanged_ = true;
+                }
             return true;
               
         }
 
+        bool Problem::RemoveEdge(std::shared_ptr<Edge> edge)
+        {
+            if (edges_.find(edge->Id()) == edges_.end())
+                return false;
+            edges_.erase(edge->Id());
+
+            // 只需要遍历这条边的各个顶点所连接的边
+            const auto &verticies = edge->Verticies();
+            for (auto &vertex: verticies)
+            {
+                auto range = vertexToEdge_.equal_range(vertex->Id());
+                for (auto it = range.first; it != range.second; ++it)
+                {
+                    if (it->second->Id() == edge->Id())
+                    {
+                        vertexToEdge_.erase(it);
+                        break;
+                    }
+                }
+            }
+
+            // edgeList_ 中留一个空位，下次 SetOrdering 时再压缩
+            // 同一条边也加到了别的 Problem 中时 OrderingId 可能被改写，此时退回查找
+            int pos = edge->OrderingId();
+            if (pos < 0 || pos >= static_cast<int>(edgeList_.size()) || edgeList_[pos] != edge)
+                pos = static_cast<int>(std::find(edgeList_.begin(), edgeList_.end(), edge) - edgeList_.begin());
+            edgeList_[pos] = nullptr;
+            edge->SetOrderingId(-1);
+            edgeListHoles_ = true;
+            edgeRunsValid_ = false;
+
+            // 某个非零块不再有边时需要重建稀疏结构
+            for (size_t i = 0; i < verticies.size(); ++i)
+                for (size_t j = i + 1; j < verticies.size(); ++j)
+                {
+                    auto it = blockPairCount_.find(VertexPair(verticies[i]->Id(), verticies[j]->Id()));
+                    if (--it->second == 0)
+                    {
+                        blockPairCount_.erase(it);
+                        topologyChanged_ = true;
+                    }
+                }
+            return true;
+        }
+
+        int Problem::EdgeTypeBucket(const std::type_info &type)
+        {
+            auto it = edgeTypeBuckets_.find(std::type_index(type));
+            if (it != edgeTypeBuckets_.end())
+                return it->second;
+            int bucket = static_cast<int>(edgeBucketTypes_.size());
+            edgeTypeBuckets_.insert(std::make_pair(std::type_index(type), bucket));
+            edgeBucketTypes_.push_back(std::type_index(type));
+            edgeKernels_.push_back(EdgeKernel::Of<Edge>());
+            return bucket;
+        }
+
+        int Problem::CompareVertexTuples(const Edge &a, const Edge &b)
+        {
+            const auto &va = a.Verticies();
+            const auto &vb = b.Verticies();
+            for (size_t i = 0; i < va.size() && i < vb.size(); ++i)
+            {
+                if (va[i]->Id() != vb[i]->Id())
+                    return va[i]->Id() < vb[i]->Id() ? -1 : 1;
+            }
+            if (va.size() != vb.size())
+                return va.size() < vb.size() ? -1 : 1;
+            return 0;
+        }
+
+        bool Problem::EdgeBefore(const Edge &a, const Edge &b) const
+        {
+            if (groupedAssembly_)
+            {
+                int c = CompareVertexTuples(a, b);
+                if (c != 0)
+                    return c < 0;
+            }
+            return a.Id() < b.Id();
+        }
+
+        size_t Problem::FirstEdgeRun(size_t k) const
+        {
+            return std::upper_bound(edgeRuns_.begin(), edgeRuns_.end(), k,
+                                    [](size_t index, const EdgeRun &run) { return index < run.end; }) -
+                   edgeRuns_.begin();
+        }
+
+        bool Problem::RemoveVertex(std::shared_ptr<Vertex> vertex)
+        {
+            if (verticies_.find(vertex->Id()) == verticies_.end())
+                return false;
+            // 先验中的顶点只能边缘化，直接删除会让先验失去意义
+            for (auto &v: priorVertices_)
+            {
+                if (v->Id() == vertex->Id())
+                {
+                    std::cerr << "vertex " << vertex->Id() << " is in the prior, marginalize it instead" << std::endl;
+                    return false;
+                }
+            }
+
+            // 与该顶点相连的边一起删除
+            std::vector<std::shared_ptr<Edge>> connected;
+            auto range = vertexToEdge_.equal_range(vertex->Id());
+            for (auto it = range.first; it != range.second; ++it)
+                connected.push_back(it->second);
+            for (auto &edge: connected)
+                RemoveEdge(edge);
+
+            verticies_.erase(vertex->Id());
+            if (problemType_ == ProblemType::SLAM_PROBLEM)
+            {
+                idx_pose_vertices_.erase(vertex->Id());
+                idx_landmark_vertices_.erase(vertex->Id());
+            }
+            vertex->SetOrderingId(-1);
+            UnbindState(vertex.get());
+            vertexList_.clear();    // 下次 SetOrdering 时重建，避免留下已删除顶点的指针
+            orderingValid_ = false;
+            topologyChanged_ = true;
+            return true;
+        }
+
+        bool Problem::MarginalizeFrame(const std::vector<std::shared_ptr<Vertex>> &margVertices)
+        {
+            std::unordered_set<ulong> marg_ids;
+            for (auto &v: margVertices)
+            {
+                if (verticies_.find(v->Id()) == verticies_.end())
+                    return false;
+                marg_ids.insert(v->Id());
+            }
+
+            // 与被边缘化顶点相连的边
+            std::vector<std::shared_ptr<Edge>> marg_edges;
+            std::unordered_set<ulong> edge_ids;
+            for (auto &v: margVertices)
+            {
+                auto range = vertexToEdge_.equal_range(v->Id());
+                for (auto it = range.first; it != range.second; ++it)
+                {
+                    if (edge_ids.insert(it->second->Id()).second)
+                        marg_edges.push_back(it->second);
+                }
+            }
+            std::sort(marg_edges.begin(), marg_edges.end(),
+                      [](const std::shared_ptr<Edge> &a, const std::shared_ptr<Edge> &b) { return a->Id() < b->Id(); });
+
+            // 局部的 ordering: 先保留的边界顶点 (已有先验中的顶点在前)，再被边缘化的顶点
+            // 固定的顶点没有增量，不进入先验
+            std::vector<std::shared_ptr<Vertex>> keep;
+            std::unordered_map<ulong, int> local_offset;
+            int keep_dim = 0;
+            auto AddKeep = [&](const std::shared_ptr<Vertex> &v) {
+                if (v->IsFixed() || marg_ids.count(v->Id()) || local_offset.count(v->Id())) return;
+                local_offset[v->Id()] = keep_dim;
+                keep_dim += v->LocalDimension();
+                keep.push_back(v);
+            };
+            for (auto &v: priorVertices_)
+                AddKeep(v);
+            for (auto &edge: marg_edges)
+                for (auto &v: edge->Verticies())
+                    AddKeep(v);
+            int local_dim = keep_dim;
+            for (auto &v: margVertices)
+            {
+                if (v->IsFixed()) continue;
+                local_offset[v->Id()] = local_dim;
+                local_dim += v->LocalDimension();
+            }
+            int marg_dim = local_dim - keep_dim;
+
+            // 残差在当前状态下计算，雅可比对已在先验中的顶点取第一次估计
+            MatXX H(MatXX::Zero(local_dim, local_dim));
+            VecX b(VecX::Zero(local_dim));
+            ++stateEpoch_;     // 顶点可能在 Solve 之外被修改过
+            for (auto &edge: marg_edges)
+                EvaluateResidual(*edge);
+            UsePriorFirstEstimates(true);
+            for (auto &edge: marg_edges)
+            {
+                edge->ComputeJacobians();
+                edge->WhitenJacobians();
+                const auto &verticies = edge->Verticies();
+                for (size_t i = 0; i < verticies.size(); ++i)
+                {
+                    auto it_i = local_offset.find(verticies[i]->Id());
+                    if (it_i == local_offset.end()) continue;
+                    int oi = it_i->second, di = verticies[i]->LocalDimension();
+                    for (size_t j = 0; j < verticies.size(); ++j)
+                    {
+                        auto it_j = local_offset.find(verticies[j]->Id());
+                        if (it_j == local_offset.end()) continue;
+                        int oj = it_j->second, dj = verticies[j]->LocalDimension();
+                        if (edge->IsFixedSize())
+                            edge->AddHessianBlock(i, j, H.block(oi, oj, di, dj));
+                        else
+                            H.block(oi, oj, di, dj).noalias() += edge->Jacobians()[i].transpose() *
+                                                                 edge->Jacobians()[j];
+                    }
+                    if (edge->IsFixedSize())
+                        edge->AddGradientBlock(i, b.segment(oi, di));
+                    else
+                        b.segment(oi, di).noalias() -= edge->Jacobians()[i].transpose() * edge->Residual();
+                }
+            }
+            UsePriorFirstEstimates(false);
+
+            // 已有的先验
+            for (size_t a = 0; a < priorVertices_.size(); ++a)
+            {
+                auto it_a = local_offset.find(priorVertices_[a]->Id());
+                if (it_a == local_offset.end()) continue;
+                int da = priorVertices_[a]->LocalDimension();
+                for (size_t c = 0; c < priorVertices_.size(); ++c)
+                {
+                    auto it_c = local_offset.find(priorVertices_[c]->Id());
+                    if (it_c == local_offset.end()) continue;
+                    int dc = priorVertices_[c]->LocalDimension();
+                    H.block(it_a->second, it_c->second, da, dc) += H_prior_.block(priorOffsets_[a], priorOffsets_[c], da, dc);
+                }
+                b.segment(it_a->second, da) += b_prior_.segment(priorOffsets_[a], da);
+            }
+
+            // Schur 补: H_prior = H_rr - H_rm H_mm^-1 H_mr, H_mm 可能奇异，用特征值分解求伪逆
+            const double eps = 1e-8;
+            MatXX H_mm = 0.5 * (H.bottomRightCorner(marg_dim, marg_dim) +
+                                H.bottomRightCorner(marg_dim, marg_dim).transpose());
+            Eigen::SelfAdjointEigenSolver<MatXX> saes_mm(H_mm);
+            VecX inv_values = (saes_mm.eigenvalues().array() > eps).select(saes_mm.eigenvalues().array().inverse(), 0);
+            MatXX H_mm_inv = saes_mm.eigenvectors() * inv_values.asDiagonal() * saes_mm.eigenvectors().transpose();
+
+            MatXX H_rm_H_mm_inv = H.topRightCorner(keep_dim, marg_dim) * H_mm_inv;
+            H_prior_ = H.topLeftCorner(keep_dim, keep_dim) - H_rm_H_mm_inv * H.bottomLeftCorner(marg_dim, keep_dim);
+            b_prior_ = b.head(keep_dim) - H_rm_H_mm_inv * b.tail(marg_dim);
+
+            // H_prior = J^T J，去掉数值误差带来的负特征值，并求 err_prior = -J^-T b_prior
+            Eigen::SelfAdjointEigenSolver<MatXX> saes(0.5 * (H_prior_ + H_prior_.transpose()));
+            VecX S = (saes.eigenvalues().array() > eps).select(saes.eigenvalues().array(), 0);
+            VecX S_inv = (saes.eigenvalues().array() > eps).select(saes.eigenvalues().array().inverse(), 0);
+            VecX S_sqrt = S.cwiseSqrt();
+            VecX S_inv_sqrt = S_inv.cwiseSqrt();
+            MatXX J = S_sqrt.asDiagonal() * saes.eigenvectors().transpose();
+            H_prior_ = J.transpose() * J;
+            Jt_prior_inv_ = S_inv_sqrt.asDiagonal() * saes.eigenvectors().transpose();
+            err_prior_ = -Jt_prior_inv_ * b_prior_;
+
+            // 已在先验中的顶点沿用原来的第一次估计，新加入的顶点取当前值
+            std::vector<VecX> first_estimates(keep.size());
+            for (size_t k = 0; k < keep.size(); ++k)
+            {
+                first_estimates[k] = keep[k]->Parameters();
+                for (size_t a = 0; a < priorVertices_.size(); ++a)
+                {
+                    if (priorVertices_[a]->Id() == keep[k]->Id())
+                    {
+                        first_estimates[k] = priorFirstEstimates_[a];
+                        break;
+                    }
+                }
+            }
+            priorFirstEstimates_.swap(first_estimates);
+            priorVertices_ = keep;
+            priorOffsets_.resize(keep.size());
+            for (size_t k = 0; k < keep.size(); ++k)
+                priorOffsets_[k] = local_offset[keep[k]->Id()];
+
+            // 删除被边缘化的顶点以及与之相连的边
+            for (auto &v: margVertices)
+                RemoveVertex(v);
+            topologyChanged_ = true;
+            return true;
+        }
+
         bool Problem::Solve(int iterations)
         {
+            SolveOptions options;
+            options.max_iterations = iterations;
+            return Solve(options);
+        }
+
+        bool Problem::Solve(const SolveOptions &options)
+        {
+            summary_.Reset();
             if(edges_.size()==0 || verticies_.size()==0)
             {
                 std::cerr<<" cannot solve problem without edges or verticies"<<std::endl;
@@ -69,68 +392,218 @@ namespace myslam
 
             TicToc t_solve;
 
+            // 两次 Solve 之间顶点可能被外部修改，之前的残差都不能再用
+            ++stateEpoch_;
+
+            // 拓扑变了，之前的填充排序作废，先回到自然顺序再重新计算
+            if (topologyChanged_)
+            {
+                fillOrderingValid_ = false;
+                if (fillOrderingPermuted_)
+                    orderingValid_ = false;
+            }
+
             //统计优化变量的维数，为构建H矩阵做准备
             SetOrdering();
 
+            // 选择稠密或稀疏的 H
+            // SLAM 问题总是以稀疏方式存储，迭代法只需要稀疏存储的对角块
+            useIterativeSolver_ = linearSolverType_ == LinearSolverType::ITERATIVE;
+            useSparseHessian_ = useIterativeSolver_ ||
+                                problemType_ == ProblemType::SLAM_PROBLEM ||
+                                linearSolverType_ == LinearSolverType::SPARSE ||
+                                (linearSolverType_ == LinearSolverType::AUTO &&
+                                 ordering_generic_ > kMaxDenseDimension);
+            if (useSparseHessian_)
+            {
+                MakeHessianStructure();
+                // 不能用 Schur 补的稀疏分解先做减少填充的排序，重排后结构需要重建
+                if (!useSchur_ && !useIterativeSolver_ && ApplyFillReducingOrdering())
+                    MakeHessianStructure();
+            }
+            LayoutStates();
+
             //遍历边，构建H矩阵
+            TicToc t_linearize;
             MakeHessian();
+            double linearize_cost = t_linearize.toc();
+            SaveStates();
+            initialGradientNorm_ = b_.norm();
                 // LM 初始化
              ComputeLambdaInitLM();
-            // LM 算法迭代求解
-            bool stop = false;
-             int iter = 0;
-                 while (!stop && (iter < iterations))
-                  {
-                std::cout << "iter: " << iter << " , chi= " << currentChi_ << " , Lambda= " << currentLambda_
-                  << std::endl;
-            bool oneStepSuccess = false;
-            int false_cnt = 0;
-         while (!oneStepSuccess)  // 不断尝试 Lambda, 直到成功迭代一步
-        {
-            // setLambda
-            AddLambdatoHessianLM();
-            // 第四步，解线性方程 H X = B
-            SolveLinearSystem();
-            //
-            RemoveLambdaHessianLM();
-
-            // 优化退出条件1： delta_x_ 很小则退出
-            if (delta_x_.squaredNorm() <= 1e-6 || false_cnt > 10) {
-                stop = true;
-                break;
-            }
-
-            // 更新状态量 X = X+ delta_x
-            UpdateStates();
-            // 判断当前步是否可行以及 LM 的 lambda 怎么更新
-            oneStepSuccess = IsGoodStepInLM();
-            // 后续处理，
-            if (oneStepSuccess) 
+            lm_.RecordLinearizeCost(linearize_cost);
+            summary_.initial_chi2 = lm_.Chi2();
+            // LM 算法迭代求解，每次尝试之前检查停止条件
+            StopReason reason = StopReason::MAX_ITERATIONS;
+            while (!lm_.StopBeforeTrial(options, summary_.linear_solves, reason))
             {
+                if (verbose_ && lm_.Rejections() == 0)
+                    std::cout << "iter: " << lm_.Iteration() << " , chi= " << lm_.Chi2()
+                              << " , Lambda= " << lm_.Lambda() << std::endl;
+
+                TicToc t_trial;
+                IterationSummary step;
+                step.iteration = lm_.Iteration();
+                step.lambda = lm_.Lambda();
+
+                // setLambda
+                TicToc t_phase;
+                AddLambdatoHessianLM();
+                summary_.damping_time += t_phase.toc();
+                // 第四步，解线性方程 H X = B
+                t_phase.tic();
+                bool solved = SolveLinearSystem();
+                ++summary_.linear_solves;
+                summary_.linear_solver_time += t_phase.toc();
+                //
+                t_phase.tic();
+                RemoveLambdaHessianLM();
+                summary_.damping_time += t_phase.toc();
+
+                bool oneStepSuccess = false;
+                if (solved)
+                {
+                    // 优化退出条件1： delta_x_ 很小则退出
+                    if (delta_x_.squaredNorm() <= 1e-6)
+                    {
+                        reason = StopReason::SMALL_STEP;
+                        break;
+                    }
+
+                    // 更新状态量 X = X+ delta_x
+                    t_phase.tic();
+                    UpdateStates();
+                    summary_.update_time += t_phase.toc();
+                    // 判断当前步是否可行以及 LM 的 lambda 怎么更新
+                    oneStepSuccess = IsGoodStepInLM();
+                    if (!oneStepSuccess)
+                    {
+                        t_phase.tic();
+                        RollbackStates();   // 误差没下降，回滚到线性化点的状态
+                        summary_.update_time += t_phase.toc();
+                    }
+                }
+                else
+                {
+                    // H + lambda I 分解失败，当作一次被拒绝的尝试加大 lambda
+                    trialChi_ = lm_.Chi2();
+                    delta_x_.setZero();
+                    lm_.RejectStep();
+                }
+                lm_.RecordTrialCost(t_trial.toc());
+
+                step.chi2 = trialChi_;
+                step.step_norm = delta_x_.norm();
+                step.accepted = oneStepSuccess;
+                step.time = t_solve.toc();
+                summary_.iterations.push_back(step);
+                bool proceed = !options.callback || options.callback(step);
+                // 被拒绝时只检查回调；被接受时还检查 chi2 阈值、迭代次数和重新线性化是否会超时
+                if (lm_.StopAfterTrial(options, oneStepSuccess, proceed, reason))
+                    break;
+                if (!oneStepSuccess)
+                    continue;
+
                 // 在新线性化点 构建 hessian
+                t_linearize.tic();
                 MakeHessian();
-                false_cnt = 0;
-            } 
-            else 
+                lm_.RecordLinearizeCost(t_linearize.toc());
+                t_phase.tic();
+                SaveStates();
+                summary_.update_time += t_phase.toc();
+            }
+            summary_.stop_reason = reason;
+            summary_.final_chi2 = lm_.Chi2();
+            summary_.num_vertices = verticies_.size();
+            summary_.num_edges = edges_.size();
+            summary_.num_parameters = ordering_generic_;
+            summary_.allocated_bytes = AllocatedBytes();
+            if (useSparseHessian_ && !useSchur_ && !useIterativeSolver_)
             {
-                false_cnt++;
-                RollbackStates();   // 误差没下降，回滚
+                summary_.factor_nonzeros = factorNonZeros_;
+                summary_.factor_flops = factorFlops_;
             }
-        }
-        iter++;
-
-        // 优化退出条件3： currentChi_ 跟第一次的chi2相比，下降了 1e6 倍则退出
-        if (sqrt(currentChi_) <= stopThresholdLM_)
-            stop = true;
-         }
-          std::cout << "problem solve cost: " << t_solve.toc() << " ms" << std::endl;
-            std::cout << "   makeHessian cost: " << t_hessian_cost_ << " ms" << std::endl;
+            summary_.total_time = t_solve.toc();
+            if (verbose_)
+                std::cout << summary_.BriefReport() << std::endl;
           return   true;
 
     }
 
         void Problem::SetOrdering() 
         {
+        // 增删边之后压缩 edgeList_，同类的边排在一起，边按这个顺序分给各线程
+        if (edgeListHoles_ || !edgeListSorted_)
+        {
+            size_t count = 0;
+            for (size_t k = 0; k < edgeList_.size(); ++k)
+            {
+                if (!edgeList_[k]) continue;
+                edgeList_[count].swap(edgeList_[k]);
+                edgeListBuckets_[count++] = edgeListBuckets_[k];
+            }
+            edgeList_.resize(count);
+            edgeListBuckets_.resize(count);
+            if (!edgeListSorted_)
+            {
+                // 按 (类型, id) 排序，分组装配时为 (类型, 顶点, id)
+                // 类型之间的顺序由 type_index 决定，与桶的编号 (出现的先后) 无关
+                std::vector<int> bucket_rank(edgeBucketTypes_.size());
+                std::vector<int> buckets(edgeBucketTypes_.size());
+                for (size_t k = 0; k < buckets.size(); ++k)
+                    buckets[k] = static_cast<int>(k);
+                std::sort(buckets.begin(), buckets.end(),
+                          [this](int a, int b) { return edgeBucketTypes_[a] < edgeBucketTypes_[b]; });
+                for (size_t k = 0; k < buckets.size(); ++k)
+                    bucket_rank[buckets[k]] = static_cast<int>(k);
+
+                auto before = [this, &bucket_rank](size_t a, size_t b) {
+                    int rank_a = bucket_rank[edgeListBuckets_[a]], rank_b = bucket_rank[edgeListBuckets_[b]];
+                    if (rank_a != rank_b)
+                        return rank_a < rank_b;
+                    return EdgeBefore(*edgeList_[a], *edgeList_[b]);
+                };
+                // 往往已经是这个顺序 (例如只是切换了分组装配)，先检查一遍
+                bool in_order = true;
+                for (size_t k = 1; k < count && in_order; ++k)
+                    in_order = before(k - 1, k);
+                if (!in_order)
+                {
+                    std::vector<size_t> order(count);
+                    for (size_t k = 0; k < count; ++k)
+                        order[k] = k;
+                    std::sort(order.begin(), order.end(), before);
+                    std::vector<std::shared_ptr<Edge>> sorted(count);
+                    std::vector<int> sorted_buckets(count);
+                    for (size_t k = 0; k < count; ++k)
+                    {
+                        sorted[k].swap(edgeList_[order[k]]);
+                        sorted_buckets[k] = edgeListBuckets_[order[k]];
+                    }
+                    edgeList_.swap(sorted);
+                    edgeListBuckets_.swap(sorted_buckets);
+                }
+            }
+            for (size_t k = 0; k < edgeList_.size(); ++k)
+                edgeList_[k]->SetOrderingId(static_cast<int>(k));
+            edgeListHoles_ = false;
+            edgeListSorted_ = true;
+        }
+        if (!edgeRunsValid_)
+        {
+            edgeRuns_.clear();
+            for (size_t k = 0; k < edgeList_.size(); ++k)
+            {
+                if (edgeRuns_.empty() || edgeRuns_.back().bucket != edgeListBuckets_[k])
+                    edgeRuns_.push_back(EdgeRun{k, k, edgeListBuckets_[k]});
+                edgeRuns_.back().end = k + 1;
+            }
+            edgeRunsValid_ = true;
+        }
+
+        // 顶点没有增删时 ordering 不变
+        if (orderingValid_)
+            return;
 
             // 每次重新计数
              ordering_poses_ = 0;
@@ -139,10 +612,321 @@ namespace myslam
 
         // Note:: verticies_ 是 map 类型的, 顺序是按照 id 号排序的
         // 统计带估计的所有变量的总维度
-        for (auto vertex: verticies_) 
-         {
-             ordering_generic_ += vertex.second->LocalDimension();  // 所有的优化变量总维数
-          }
+        if (problemType_ == ProblemType::SLAM_PROBLEM)
+        {
+            // pose 和 landmark 在增删顶点时已经分好类，pose 在前 landmark 在后
+            vertexList_.clear();
+            for (auto &pose: idx_pose_vertices_)
+            {
+                vertexList_.push_back(pose.second.get());
+                pose.second->SetOrderingId(ordering_poses_);
+                ordering_poses_ += pose.second->LocalDimension();
+            }
+            for (auto &landmark: idx_landmark_vertices_)
+            {
+                vertexList_.push_back(landmark.second.get());
+                landmark.second->SetOrderingId(ordering_poses_ + ordering_landmarks_);
+                ordering_landmarks_ += landmark.second->LocalDimension();
+            }
+            ordering_generic_ = ordering_poses_ + ordering_landmarks_;
+        }
+        else
+        {
+            vertexList_.clear();
+            for (auto &vertex: verticies_) 
+            {
+                vertexList_.push_back(vertex.second.get());
+                vertex.second->SetOrderingId(ordering_generic_);
+                ordering_generic_ += vertex.second->LocalDimension();  // 所有的优化变量总维数
+            }
+        }
+        // vertexList_ 变了，状态向量需要重新排列，填充排序也要在自然顺序上重新计算
+        stateLayoutValid_ = false;
+        fillOrderingValid_ = false;
+        fillOrderingPermuted_ = false;
+        orderingValid_ = true;
+        }
+
+        void Problem::SetOrderingType(OrderingType type)
+        {
+            if (type == orderingType_)
+                return;
+            orderingType_ = type;
+            fillOrderingValid_ = false;
+            orderingValid_ = false;
+        }
+
+        void Problem::SetGroupedAssembly(bool grouped)
+        {
+            if (grouped == groupedAssembly_)
+                return;
+            groupedAssembly_ = grouped;
+            // 边的排序键变了
+            if (!edgeList_.empty())
+            {
+                edgeListSorted_ = false;
+                edgeRunsValid_ = false;
+            }
+        }
+
+        bool Problem::ApplyFillReducingOrdering()
+        {
+            if (fillOrderingValid_)
+                return false;
+            fillOrderingValid_ = true;
+
+            // 块图: vertexList_ 中的每个顶点是一个结点，非零块 (包括先验的稠密块) 是边
+            int num_blocks = static_cast<int>(vertexList_.size());
+            std::unordered_map<ulong, int> vertex_block;
+            BlockGraph graph;
+            graph.adjacency.resize(num_blocks);
+            graph.weights.resize(num_blocks);
+            for (int k = 0; k < num_blocks; ++k)
+            {
+                vertex_block[vertexList_[k]->Id()] = k;
+                graph.weights[k] = vertexList_[k]->LocalDimension();
+            }
+            auto Connect = [&graph](int a, int c) {
+                graph.adjacency[a].push_back(c);
+                graph.adjacency[c].push_back(a);
+            };
+            for (auto &pair_count: blockPairCount_)
+                Connect(vertex_block[pair_count.first.first], vertex_block[pair_count.first.second]);
+            for (size_t a = 0; a < priorVertices_.size(); ++a)
+                for (size_t c = a + 1; c < priorVertices_.size(); ++c)
+                    Connect(vertex_block[priorVertices_[a]->Id()], vertex_block[priorVertices_[c]->Id()]);
+
+            std::vector<int> order;
+            switch (orderingType_)
+            {
+                case OrderingType::MINIMUM_DEGREE:
+                    MinimumDegreeOrdering(graph, order);
+                    break;
+                case OrderingType::NESTED_DISSECTION:
+                    NestedDissectionOrdering(graph, order);
+                    break;
+                default:
+                    order.resize(num_blocks);
+                    for (int k = 0; k < num_blocks; ++k)
+                        order[k] = k;
+                    break;
+            }
+            SymbolicFactorization(graph, order, factorNonZeros_, factorFlops_);
+
+            bool identity = true;
+            for (int k = 0; k < num_blocks && identity; ++k)
+                identity = order[k] == k;
+            if (identity)
+                return false;
+
+            // 按新的顺序重新分配 ordering id，H 的块顺序随之改变
+            std::vector<Vertex *> natural(vertexList_);
+            ulong ordering_id = 0;
+            for (int k = 0; k < num_blocks; ++k)
+            {
+                vertexList_[k] = natural[order[k]];
+                vertexList_[k]->SetOrderingId(ordering_id);
+                ordering_id += vertexList_[k]->LocalDimension();
+            }
+            stateLayoutValid_ = false;
+            fillOrderingPermuted_ = true;
+            topologyChanged_ = true;
+            return true;
+        }
+
+        void Problem::LayoutStates()
+        {
+            // 顶点被另一个 Problem 重新绑定过时，参数已经不在 state_ 中
+            if (stateLayoutValid_)
+            {
+                for (size_t k = 0; k < vertexList_.size(); ++k)
+                {
+                    if (vertexList_[k]->Parameters().data() != state_.data() + stateOffsets_[k])
+                    {
+                        stateLayoutValid_ = false;
+                        break;
+                    }
+                }
+            }
+
+            if (!stateLayoutValid_)
+            {
+                stateOffsets_.resize(vertexList_.size());
+                ulong size = 0;
+                for (size_t k = 0; k < vertexList_.size(); ++k)
+                {
+                    stateOffsets_[k] = size;
+                    size += vertexList_[k]->Dimension();
+                }
+                // 参数从旧的位置 (旧的 state_ 或顶点自己的存储) 拷到新的状态向量，再交换
+                VecX state(size);
+                for (size_t k = 0; k < vertexList_.size(); ++k)
+                    vertexList_[k]->BindParameters(state.data() + stateOffsets_[k]);
+                state_.swap(state);
+                stateLayoutValid_ = true;
+            }
+
+            // 固定与否在两次求解之间可能改变，分段每次重新计算
+            // 参数和增量在各自数组中都连续的向量空间顶点合并成一段，更新时只做一次向量加
+            stateRuns_.clear();
+            manifoldVertices_.clear();
+            for (size_t k = 0; k < vertexList_.size(); ++k)
+            {
+                Vertex *vertex = vertexList_[k];
+                if (vertex->IsFixed()) continue;
+                if (!vertex->IsVectorSpace())
+                {
+                    manifoldVertices_.push_back(vertex);
+                    continue;
+                }
+                ulong dim = vertex->Dimension();
+                if (!stateRuns_.empty() &&
+                    stateRuns_.back().state + stateRuns_.back().size == stateOffsets_[k] &&
+                    stateRuns_.back().delta + stateRuns_.back().size == static_cast<ulong>(vertex->OrderingId()))
+                {
+                    stateRuns_.back().size += dim;
+                }
+                else
+                {
+                    stateRuns_.push_back(StateRun{stateOffsets_[k], static_cast<ulong>(vertex->OrderingId()), dim});
+                }
+            }
+        }
+
+        void Problem::UnbindState(Vertex *vertex)
+        {
+            const double *data = vertex->Parameters().data();
+            if (data >= state_.data() && data < state_.data() + state_.size())
+            {
+                vertex->UnbindParameters();
+                stateLayoutValid_ = false;
+            }
+        }
+
+        const VecX &Problem::State()
+        {
+            SetOrdering();
+            LayoutStates();
+            return state_;
+        }
+
+        bool Problem::SetState(const VecX &state)
+        {
+            SetOrdering();
+            LayoutStates();
+            if (state.size() != state_.size())
+                return false;
+            state_ = state;
+            ++stateEpoch_;
+            return true;
+        }
+
+        bool Problem::IsPoseVertex(std::shared_ptr<Vertex> v)
+        {
+            return !IsLandmarkVertex(v);    // 除了 landmark 以外都放在前面，和 pose 一起求解
+        }
+
+        bool Problem::IsLandmarkVertex(std::shared_ptr<Vertex> v)
+        {
+            string type = v->TypeInfo();
+            return type == string("VertexPointXYZ") ||
+                   type == string("VertexInverseDepth");
+        }
+
+        void Problem::AddOrderingSLAM(std::shared_ptr<Vertex> v)
+        {
+            if (IsPoseVertex(v))
+                idx_pose_vertices_.insert(pair<ulong, std::shared_ptr<Vertex>>(v->Id(), v));
+            else
+                idx_landmark_vertices_.insert(pair<ulong, std::shared_ptr<Vertex>>(v->Id(), v));
+        }
+
+        void Problem::MakeHessianStructure()
+        {
+            if (!topologyChanged_ && sparseHessian_.Rows() == static_cast<int>(ordering_generic_) &&
+                structureIterative_ == useIterativeSolver_)
+                return;
+
+            // 每个顶点是一个块，块的顺序就是 ordering 的顺序，即 vertexList_ 的顺序
+            std::vector<int> block_dims;
+            std::unordered_map<ulong, int> vertex_block;
+            block_dims.reserve(vertexList_.size());
+            for (Vertex *v: vertexList_)
+            {
+                vertex_block[v->Id()] = static_cast<int>(block_dims.size());
+                block_dims.push_back(v->LocalDimension());
+            }
+
+            // 同一条边连接的两个顶点之间有一个非零块，blockPairCount_ 在增删边时已经维护好
+            // 固定的顶点也保留它的块，这样改变 fixed 状态不需要重建结构
+            // 迭代法只需要对角块
+            std::vector<std::pair<int, int>> lower_blocks;
+            if (!useIterativeSolver_)
+            {
+                lower_blocks.reserve(blockPairCount_.size());
+                for (auto &pair_count: blockPairCount_)
+                    lower_blocks.emplace_back(vertex_block[pair_count.first.first],
+                                              vertex_block[pair_count.first.second]);
+            }
+            // 先验是稠密的，先验顶点两两之间都有非零块
+            if (!useIterativeSolver_)
+            {
+                for (size_t a = 0; a < priorVertices_.size(); ++a)
+                    for (size_t c = a + 1; c < priorVertices_.size(); ++c)
+                        lower_blocks.emplace_back(vertex_block[priorVertices_[a]->Id()],
+                                                  vertex_block[priorVertices_[c]->Id()]);
+            }
+            sparseHessian_.SetStructure(block_dims, lower_blocks);
+
+            structureIterative_ = useIterativeSolver_;
+            useSchur_ = false;
+            // 按填充排序重排过的顶点不再是 pose 在前 landmark 在后，重排本身也说明不能用 Schur 补
+            if (problemType_ == ProblemType::SLAM_PROBLEM && !useIterativeSolver_ && !fillOrderingPermuted_)
+            {
+                // landmark 块在 pose 块之后，统计每个 landmark 连接的 pose 块
+                // landmark 之间有约束时 H_ll 不是块对角的，退回普通的稀疏分解
+                int num_pose_blocks = static_cast<int>(idx_pose_vertices_.size());
+                int num_landmarks = static_cast<int>(idx_landmark_vertices_.size());
+                useSchur_ = true;
+                std::vector<std::vector<std::pair<int, int>>> landmark_slots(num_landmarks);
+                for (int col = 0; col < sparseHessian_.NumBlocks() && useSchur_; ++col)
+                {
+                    for (int slot = sparseHessian_.ColBegin(col); slot < sparseHessian_.ColEnd(col); ++slot)
+                    {
+                        int row = sparseHessian_.SlotRow(slot);
+                        if (row < num_pose_blocks || row == col) continue;
+                        if (col >= num_pose_blocks)
+                        {
+                            useSchur_ = false;
+                            break;
+                        }
+                        landmark_slots[row - num_pose_blocks].emplace_back(col, slot);
+                    }
+                }
+                landmarkSlotPtr_.assign(1, 0);
+                landmarkPoseSlots_.clear();
+                for (auto &slots: landmark_slots)
+                {
+                    landmarkPoseSlots_.insert(landmarkPoseSlots_.end(), slots.begin(), slots.end());
+                    landmarkSlotPtr_.push_back(static_cast<int>(landmarkPoseSlots_.size()));
+                }
+                H_ll_inv_.resize(num_landmarks);
+            }
+
+            // 结构变了，稀疏分解的符号分析需要重做
+            // 转置一份值为下标的下三角矩阵，得到上三角每个元素在下三角数组中的位置
+            if (!useSchur_ && !useIterativeSolver_)
+            {
+                BlockSparseMatrix::SparseMatrix index = sparseHessian_.Matrix();
+                for (long k = 0; k < index.nonZeros(); ++k)
+                    index.valuePtr()[k] = static_cast<double>(k);
+                sparseUpper_ = index.transpose();
+                upperValueIndex_.resize(sparseUpper_.nonZeros());
+                for (long k = 0; k < sparseUpper_.nonZeros(); ++k)
+                    upperValueIndex_[k] = static_cast<int>(sparseUpper_.valuePtr()[k]);
+                sparseSolver_.analyzePattern(sparseUpper_);
+            }
+            topologyChanged_ = false;
         }
 
         void Problem::MakeHessian()
@@ -150,173 +934,757 @@ namespace myslam
             TicToc t_h;
             // 直接构造大的 H 矩阵
          ulong size = ordering_generic_;
-         MatXX H(MatXX::Zero(size, size));
-         VecX b(VecX::Zero(size));
+         int num_threads = std::max(1, std::min(numThreads_, static_cast<int>(edgeList_.size())));
+
+         // 每个线程一份 H 和 b，线程 0 直接写到 Hessian_ / sparseHessian_ / b_ 里
+         if (useSparseHessian_)
+             sparseHessian_.SetZero();
+         else
+             Hessian_.setZero(size, size);
+         b_.setZero(size);
+         threadHessian_.resize(num_threads - 1);
+         threadSparseValues_.resize(num_threads - 1);
+         threadB_.resize(num_threads - 1);
+         if (groupedAssembly_)
+             threadStack_.resize(num_threads);
+
+        // FEJ: 与先验顶点相连的边先在当前状态下算好残差，雅可比再换到第一次估计上计算
+        if (!priorVertices_.empty())
+        {
+            for (auto &v: priorVertices_)
+            {
+                auto range = vertexToEdge_.equal_range(v->Id());
+                for (auto it = range.first; it != range.second; ++it)
+                    EvaluateResidual(*it->second);
+            }
+            UsePriorFirstEstimates(true);
+        }
 
         // 遍历每个残差，并计算他们的雅克比，得到最后的 H = J^T * J
-        for (auto &edge: edges_) 
+        // 边按 id 顺序连续均分给各线程，归约的顺序也固定，所以线程数固定时结果逐位一致
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+#endif
+        for (int t = 0; t < num_threads; ++t)
         {
+            MatXX *H = &Hessian_;
+            double *sparse_values = useSparseHessian_ ? sparseHessian_.Values() : nullptr;
+            VecX *b = &b_;
+            if (t > 0)
+            {
+                if (useSparseHessian_)
+                {
+                    threadSparseValues_[t - 1].setZero(sparseHessian_.NumValues());
+                    sparse_values = threadSparseValues_[t - 1].data();
+                }
+                else
+                {
+                    threadHessian_[t - 1].setZero(size, size);
+                    H = &threadHessian_[t - 1];
+                }
+                threadB_[t - 1].setZero(size);
+                b = &threadB_[t - 1];
+            }
+
+            // 每一段同类的边交给该类型的计算核
+            size_t begin = edgeList_.size() * t / num_threads;
+            size_t end = edgeList_.size() * (t + 1) / num_threads;
+            for (size_t r = FirstEdgeRun(begin); r < edgeRuns_.size() && edgeRuns_[r].begin < end; ++r)
+            {
+                size_t lo = std::max(begin, edgeRuns_[r].begin), hi = std::min(end, edgeRuns_[r].end);
+                (this->*edgeKernels_[edgeRuns_[r].bucket].linearize)(&edgeList_[lo], hi - lo, H, sparse_values, *b, t);
+            }
+        }
+
+        // 按线程顺序归约，每个元素的求和顺序与线程调度无关
+        if (num_threads > 1)
+        {
+            long num_values = useSparseHessian_ ? sparseHessian_.NumValues() : static_cast<long>(size * size);
+            double *values = useSparseHessian_ ? sparseHessian_.Values() : Hessian_.data();
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+#endif
+            for (long k = 0; k < num_values; ++k)
+            {
+                for (int t = 1; t < num_threads; ++t)
+                    values[k] += useSparseHessian_ ? threadSparseValues_[t - 1][k] : threadHessian_[t - 1].data()[k];
+            }
+            for (int t = 1; t < num_threads; ++t)
+                b_ += threadB_[t - 1];
+        }
+        if (!priorVertices_.empty())
+            UsePriorFirstEstimates(false);
+        AddPriorToHessian();
+    summary_.linearization_time += t_h.toc();
+
+    delta_x_.setZero(size);  // initial delta_x = 0_n;
 
-        edge.second->ComputeResidual();
-        edge.second->ComputeJacobians();
+    // 保存不含 lambda 的对角线，加减 lambda 时从这里恢复
+    if (useSparseHessian_)
+        sparseHessian_.GetDiagonal(hessianDiagonal_);
+    else
+        hessianDiagonal_ = Hessian_.diagonal();
+
+    }
 
-        auto jacobians = edge.second->Jacobians();
-        auto verticies = edge.second->Verticies();
+        void Problem::AddEdgeToHessian(const Edge &edge, MatXX *H, double *sparse_values, VecX &b)
+        {
+        const auto &jacobians = edge.Jacobians();
+        const auto &verticies = edge.Verticies();
         assert(jacobians.size() == verticies.size());
         for (size_t i = 0; i < verticies.size(); ++i) 
         {
-            auto v_i = verticies[i];
+            const Vertex *v_i = verticies[i].get();
             if (v_i->IsFixed()) continue;    // Hessian 里不需要添加它的信息，也就是它的雅克比为 0
 
-            auto jacobian_i = jacobians[i];
+            const MatXX &jacobian_i = jacobians[i];
             ulong index_i = v_i->OrderingId();
             ulong dim_i = v_i->LocalDimension();
 
-            MatXX JtW = jacobian_i.transpose() * edge.second->Information();
+            // 雅可比已经白化，H_ij = J_i^T J_j，不需要再乘信息矩阵
+            auto Jt = jacobian_i.transpose();
             for (size_t j = i; j < verticies.size(); ++j) 
             {
-                auto v_j = verticies[j];
+                const Vertex *v_j = verticies[j].get();
 
                 if (v_j->IsFixed()) continue;
+                if (useIterativeSolver_ && j != i) continue;  // 迭代法只累加对角块
 
-                auto jacobian_j = jacobians[j];
+                const MatXX &jacobian_j = jacobians[j];
                 ulong index_j = v_j->OrderingId();
                 ulong dim_j = v_j->LocalDimension();
 
                 assert(v_j->OrderingId() != -1);
-                MatXX hessian = JtW * jacobian_j;
+                if (useSparseHessian_)
+                {
+                    // 稀疏 H 只存下三角的块
+                    int block_i = sparseHessian_.BlockIndex(index_i);
+                    int block_j = sparseHessian_.BlockIndex(index_j);
+                    if (block_i >= block_j)
+                        sparseHessian_.Block(block_i, block_j, sparse_values).noalias() += Jt * jacobian_j;
+                    else
+                        sparseHessian_.Block(block_j, block_i, sparse_values).noalias() +=
+                            jacobian_j.transpose() * jacobian_i;
+                    continue;
+                }
                 // 所有的信息矩阵叠加起来
-                H.block(index_i, index_j, dim_i, dim_j).noalias() += hessian;
+                H->block(index_i, index_j, dim_i, dim_j).noalias() += Jt * jacobian_j;
                 if (j != i) 
                 {
                     // 对称的下三角
-                    H.block(index_j, index_i, dim_j, dim_i).noalias() += hessian.transpose();
+                    H->block(index_j, index_i, dim_j, dim_i).noalias() += jacobian_j.transpose() * jacobian_i;
                 }
             }
-            b.segment(index_i, dim_i).noalias() -= JtW * edge.second->Residual();
+            b.segment(index_i, dim_i).noalias() -= Jt * edge.Residual();
           }
+        }
+   
+        void Problem::StackEdge(const Edge &edge, int thread)
+        {
+            EdgeStack &stack = threadStack_[thread];
+            const auto &verticies = edge.Verticies();
+            if (!stack.verticies)
+            {
+                // 一组的第一条边，缓存只增不减，稳定后不再分配内存
+                stack.verticies = &verticies;
+                stack.cols = 0;
+                for (const auto &vertex: verticies)
+                    if (!vertex->IsFixed())
+                        stack.cols += vertex->LocalDimension();
+                int capacity = kStackRows + maxResidualDimension_;
+                if (stack.J.rows() < capacity || stack.J.cols() < stack.cols)
+                    stack.J.resize(capacity, std::max<int>(stack.cols, stack.J.cols()));
+                if (stack.r.size() < capacity)
+                    stack.r.resize(capacity);
+                if (stack.JtJ.rows() < stack.cols)
+                {
+                    stack.JtJ.resize(stack.cols, stack.cols);
+                    stack.Jtr.resize(stack.cols);
+                }
+                stack.JtJ.topLeftCorner(stack.cols, stack.cols).setZero();
+                stack.Jtr.head(stack.cols).setZero();
+                stack.rows = 0;
+            }
 
-       }
-    Hessian_ = H;
-    b_ = b;
-    t_hessian_cost_ += t_h.toc();
+            int residual_dim = static_cast<int>(edge.Residual().rows());
+            if (stack.rows + residual_dim > kStackRows)
+                FlushEdgeStack(thread);
 
-    delta_x_ = VecX::Zero(size);  // initial delta_x = 0_n;
+            // 逐个元素复制，行数列数都很小，避免动态大小的块赋值的开销
+            const auto &jacobians = edge.Jacobians();
+            const long stride = stack.J.rows();
+            double *column = stack.J.data() + stack.rows;
+            for (size_t i = 0; i < verticies.size(); ++i)
+            {
+                if (verticies[i]->IsFixed()) continue;
+                const double *source = jacobians[i].data();
+                for (long c = 0; c < jacobians[i].cols(); ++c, column += stride, source += residual_dim)
+                    for (int r = 0; r < residual_dim; ++r)
+                        column[r] = source[r];
+            }
+            const double *residual = edge.Residual().data();
+            for (int r = 0; r < residual_dim; ++r)
+                stack.r[stack.rows + r] = residual[r];
+            stack.rows += residual_dim;
+        }
+
+        void Problem::FlushEdgeStack(int thread)
+        {
+            EdgeStack &stack = threadStack_[thread];
+            if (stack.rows == 0 || stack.cols == 0)
+            {
+                stack.rows = 0;
+                return;
+            }
+            auto J = stack.J.topLeftCorner(stack.rows, stack.cols);
+            auto JtJ = stack.JtJ.topLeftCorner(stack.cols, stack.cols);
+            // 列数很少时 BLAS-3 的打包开销比计算还大，按系数直接相乘更快
+            if (stack.cols <= kNarrowStackCols)
+                JtJ.noalias() += J.transpose().lazyProduct(J);
+            else
+                JtJ.selfadjointView<Eigen::Lower>().rankUpdate(J.transpose());
+            stack.Jtr.head(stack.cols).noalias() += J.transpose() * stack.r.head(stack.rows);
+            stack.rows = 0;
+        }
+
+        void Problem::AddEdgeStackToHessian(MatXX *H, double *sparse_values, VecX &b, int thread)
+        {
+            EdgeStack &stack = threadStack_[thread];
+            FlushEdgeStack(thread);
+            const auto &verticies = *stack.verticies;
+            stack.verticies = nullptr;
+            auto JtJ = stack.JtJ.topLeftCorner(stack.cols, stack.cols);
+            if (stack.cols > kNarrowStackCols)
+                JtJ.triangularView<Eigen::StrictlyUpper>() = JtJ.transpose();
+
+            // 分到各个块，顺序与 AddEdgeToHessian 相同
+            int col_i = 0;
+            for (size_t i = 0; i < verticies.size(); ++i)
+            {
+                const Vertex *v_i = verticies[i].get();
+                if (v_i->IsFixed()) continue;
+                ulong index_i = v_i->OrderingId();
+                int dim_i = v_i->LocalDimension();
+                int col_j = col_i;
+                for (size_t j = i; j < verticies.size(); ++j)
+                {
+                    const Vertex *v_j = verticies[j].get();
+                    if (v_j->IsFixed()) continue;
+                    ulong index_j = v_j->OrderingId();
+                    int dim_j = v_j->LocalDimension();
+                    if (!useIterativeSolver_ || j == i)
+                    {
+                        if (useSparseHessian_)
+                        {
+                            int block_i = sparseHessian_.BlockIndex(index_i);
+                            int block_j = sparseHessian_.BlockIndex(index_j);
+                            if (block_i >= block_j)
+                                sparseHessian_.Block(block_i, block_j, sparse_values) +=
+                                    JtJ.block(col_i, col_j, dim_i, dim_j);
+                            else
+                                sparseHessian_.Block(block_j, block_i, sparse_values) +=
+                                    JtJ.block(col_j, col_i, dim_j, dim_i);
+                        }
+                        else
+                        {
+                            H->block(index_i, index_j, dim_i, dim_j) += JtJ.block(col_i, col_j, dim_i, dim_j);
+                            if (j != i)
+                                H->block(index_j, index_i, dim_j, dim_i) += JtJ.block(col_j, col_i, dim_j, dim_i);
+                        }
+                    }
+                    col_j += dim_j;
+                }
+                b.segment(index_i, dim_i) -= stack.Jtr.segment(col_i, dim_i);
+                col_i += dim_i;
+            }
+        }
+
+        void Problem::AddPriorToHessian()
+        {
+            for (size_t a = 0; a < priorVertices_.size(); ++a)
+            {
+                const Vertex *v_a = priorVertices_[a].get();
+                if (v_a->IsFixed()) continue;
+                ulong index_a = v_a->OrderingId();
+                int dim_a = v_a->LocalDimension();
+                for (size_t c = 0; c < priorVertices_.size(); ++c)
+                {
+                    const Vertex *v_c = priorVertices_[c].get();
+                    if (v_c->IsFixed()) continue;
+                    ulong index_c = v_c->OrderingId();
+                    int dim_c = v_c->LocalDimension();
+                    auto prior_block = H_prior_.block(priorOffsets_[a], priorOffsets_[c], dim_a, dim_c);
+                    if (useSparseHessian_)
+                    {
+                        // 稀疏 H 只存下三角，迭代法只存对角块
+                        int block_a = sparseHessian_.BlockIndex(index_a);
+                        int block_c = sparseHessian_.BlockIndex(index_c);
+                        if (block_a < block_c || (useIterativeSolver_ && a != c)) continue;
+                        sparseHessian_.Block(block_a, block_c) += prior_block;
+                        continue;
+                    }
+                    Hessian_.block(index_a, index_c, dim_a, dim_c) += prior_block;
+                }
+                b_.segment(index_a, dim_a) += b_prior_.segment(priorOffsets_[a], dim_a);
+            }
+        }
+
+        void Problem::GatherPriorVector(const VecX &x, VecX &x_prior) const
+        {
+            x_prior.setZero(H_prior_.rows());
+            for (size_t a = 0; a < priorVertices_.size(); ++a)
+            {
+                const Vertex *v = priorVertices_[a].get();
+                if (v->IsFixed()) continue;
+                x_prior.segment(priorOffsets_[a], v->LocalDimension()) = x.segment(v->OrderingId(), v->LocalDimension());
+            }
+        }
+
+        void Problem::UsePriorFirstEstimates(bool first)
+        {
+            priorCurrentEstimates_.resize(priorVertices_.size());
+            for (size_t a = 0; a < priorVertices_.size(); ++a)
+            {
+                auto params = priorVertices_[a]->Parameters();
+                if (first)
+                {
+                    priorCurrentEstimates_[a] = params;
+                    params = priorFirstEstimates_[a];
+                }
+                else
+                    params = priorCurrentEstimates_[a];
+            }
+        }
+
+        double Problem::ComputeChi2()
+        {
+            // 与 MakeHessian 相同的分段方式，部分和按线程顺序相加，线程数固定时结果逐位一致
+            int num_threads = std::max(1, std::min(numThreads_, static_cast<int>(edgeList_.size())));
+            threadChi2_.assign(num_threads, 0.);
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+#endif
+            for (int t = 0; t < num_threads; ++t)
+            {
+                size_t begin = edgeList_.size() * t / num_threads;
+                size_t end = edgeList_.size() * (t + 1) / num_threads;
+                double chi2 = 0.;
+                for (size_t r = FirstEdgeRun(begin); r < edgeRuns_.size() && edgeRuns_[r].begin < end; ++r)
+                {
+                    size_t lo = std::max(begin, edgeRuns_[r].begin), hi = std::min(end, edgeRuns_[r].end);
+                    chi2 += (this->*edgeKernels_[edgeRuns_[r].bucket].chi2)(&edgeList_[lo], hi - lo);
+                }
+                threadChi2_[t] = chi2;
+            }
+
+            double chi2 = 0.;
+            for (int t = 0; t < num_threads; ++t)
+                chi2 += threadChi2_[t];
+            // 先验的 err_prior_ 在 UpdateStates 中随状态更新
+            if (err_prior_.rows() > 0)
+                chi2 += err_prior_.squaredNorm();
+            return chi2;
+        }
 
-    }
-   
    /// LM
    void Problem::ComputeLambdaInitLM() 
    {
-    ni_ = 2.;
-    currentLambda_ = -1.;
-    currentChi_ = 0.0;
     // TODO:: robust cost chi2
-    for (auto edge: edges_) 
-    {
-        currentChi_ += edge.second->Chi2();
-    }
-    if (err_prior_.rows() > 0)
-        currentChi_ += err_prior_.norm();
-
-    stopThresholdLM_ = 1e-6 * currentChi_;          // 迭代条件为 误差下降 1e-6 倍
+    // 残差在 MakeHessian 中已经算过
+    double chi2 = ComputeChi2();
 
     double maxDiagonal = 0;
-    ulong size = Hessian_.cols();
-    assert(Hessian_.rows() == Hessian_.cols() && "Hessian is not square");
+    ulong size = hessianDiagonal_.size();
     for (ulong i = 0; i < size; ++i) 
     {
-        maxDiagonal = std::max(fabs(Hessian_(i, i)), maxDiagonal);
+        maxDiagonal = std::max(fabs(hessianDiagonal_(i)), maxDiagonal);
     }
-    double tau = 1e-5;
-    currentLambda_ = tau * maxDiagonal;
+    lm_.Start(chi2, maxDiagonal);
    }
 
 
    void Problem::AddLambdatoHessianLM() 
    {
-    ulong size = Hessian_.cols();
-    assert(Hessian_.rows() == Hessian_.cols() && "Hessian is not square");
-    for (ulong i = 0; i < size; ++i)
+    // 对角线直接赋值为 保存的对角线 + lambda，不在上一次的结果上反复加减
+    if (useSparseHessian_)
     {
-        Hessian_(i, i) += currentLambda_;
+        sparseHessian_.SetDiagonal(hessianDiagonal_, lm_.Lambda());
+        return;
     }
+    assert(Hessian_.rows() == Hessian_.cols() && "Hessian is not square");
+    Hessian_.diagonal() = hessianDiagonal_.array() + lm_.Lambda();
   }
 
-  void Problem::SolveLinearSystem() 
+  bool Problem::SolveLinearSystem() 
+  {
+        if (useIterativeSolver_)
+        {
+            SolvePCG();
+            return true;
+        }
+        if (useSchur_)
+            return SolveSchurSLAM();
+        if (useSparseHessian_)
+        {
+            // 符号分析在 MakeHessianStructure 中完成，这里只做数值分解
+            const double *lower = sparseHessian_.Matrix().valuePtr();
+            double *upper = sparseUpper_.valuePtr();
+            for (size_t k = 0; k < upperValueIndex_.size(); ++k)
+                upper[k] = lower[upperValueIndex_[k]];
+            sparseSolver_.FactorizeUpper(sparseUpper_);
+            if (sparseSolver_.info() != Eigen::Success)
+                return false;
+            delta_x_ = sparseSolver_.solve(b_);
+            return true;
+        }
+
+        // 被拒绝后重试时 H 不变只有 lambda 变了，仍然重新做一次 LDLT: 稠密问题规模不大，
+        // 分解对象是成员变量，维度不变时不会重新分配内存
+        denseSolver_.compute(Hessian_);
+        if (denseSolver_.info() != Eigen::Success)
+            return false;
+        delta_x_ = denseSolver_.solve(b_);
+        return true;
+  }
+  bool Problem::SolveSchurSLAM()
   {
+        // H = [Hpp Hpl; Hlp Hll], Hll 为块对角
+        // (Hpp - Hpl Hll^-1 Hlp) dx_p = bp - Hpl Hll^-1 bl
+        // dx_l = Hll^-1 (bl - Hlp dx_p)
+        int reserve_size = ordering_poses_;
+        int num_pose_blocks = static_cast<int>(idx_pose_vertices_.size());
+        int num_landmarks = static_cast<int>(idx_landmark_vertices_.size());
 
-        delta_x_ = Hessian_.inverse() * b_;
-        // delta_x_ = H.ldlt().solve(b_);
+        schurTemp_.resize(maxLocalDimension_, maxLocalDimension_);
+        schurB_.resize(maxLocalDimension_);
 
+        // 每个 landmark 对角块单独求逆，分解对象按块的维度复用
+        if (static_cast<int>(blockLDLT_.size()) <= maxLocalDimension_)
+            blockLDLT_.resize(maxLocalDimension_ + 1);
+        for (int l = 0; l < num_landmarks; ++l)
+        {
+            int block_l = num_pose_blocks + l;
+            int dim_l = sparseHessian_.BlockDim(block_l);
+            Eigen::LDLT<MatXX> &ldlt = blockLDLT_[dim_l];
+            ldlt.compute(sparseHessian_.Block(block_l, block_l));
+            if (ldlt.info() != Eigen::Success || !ldlt.isPositive())
+                return false;
+            H_ll_inv_[l].setIdentity(dim_l, dim_l);
+            ldlt.solveInPlace(H_ll_inv_[l]);
+        }
+
+        // Hpp 只需要下三角
+        H_pp_schur_.setZero(reserve_size, reserve_size);
+        b_pp_schur_ = b_.head(reserve_size);
+        for (int col = 0; col < num_pose_blocks; ++col)
+        {
+            int offset_col = sparseHessian_.BlockOffset(col);
+            for (int slot = sparseHessian_.ColBegin(col); slot < sparseHessian_.ColEnd(col); ++slot)
+            {
+                int row = sparseHessian_.SlotRow(slot);
+                if (row >= num_pose_blocks) continue;
+                auto block = sparseHessian_.SlotBlock(slot, col);
+                H_pp_schur_.block(sparseHessian_.BlockOffset(row), offset_col, block.rows(), block.cols()) = block;
+            }
+        }
+
+        // 每个 landmark 对它连接的 pose 两两之间贡献 Hpl Hll^-1 Hlp
+        for (int l = 0; l < num_landmarks; ++l)
+        {
+            int block_l = num_pose_blocks + l;
+            int offset_l = sparseHessian_.BlockOffset(block_l);
+            int dim_l = sparseHessian_.BlockDim(block_l);
+            for (int a = landmarkSlotPtr_[l]; a < landmarkSlotPtr_[l + 1]; ++a)
+            {
+                int pose_p = landmarkPoseSlots_[a].first;
+                auto H_lp = sparseHessian_.SlotBlock(landmarkPoseSlots_[a].second, pose_p);
+                auto temp = schurTemp_.topLeftCorner(H_lp.cols(), dim_l);
+                temp.noalias() = H_lp.transpose() * H_ll_inv_[l];
+                int offset_p = sparseHessian_.BlockOffset(pose_p);
+                b_pp_schur_.segment(offset_p, H_lp.cols()).noalias() -= temp * b_.segment(offset_l, dim_l);
+                for (int c = landmarkSlotPtr_[l]; c < landmarkSlotPtr_[l + 1]; ++c)
+                {
+                    int pose_q = landmarkPoseSlots_[c].first;
+                    if (pose_q > pose_p) continue;
+                    auto H_lq = sparseHessian_.SlotBlock(landmarkPoseSlots_[c].second, pose_q);
+                    H_pp_schur_.block(offset_p, sparseHessian_.BlockOffset(pose_q), H_lp.cols(), H_lq.cols()).noalias() -=
+                        temp * H_lq;
+                }
+            }
+        }
+
+        // 求解 pose 部分，LDLT 只读取下三角
+        if (reserve_size > 0)
+        {
+            schurLDLT_.compute(H_pp_schur_);
+            if (schurLDLT_.info() != Eigen::Success || !schurLDLT_.isPositive())
+                return false;
+            delta_x_.head(reserve_size) = schurLDLT_.solve(b_pp_schur_);
+        }
+
+        // 回代求解 landmark
+        for (int l = 0; l < num_landmarks; ++l)
+        {
+            int block_l = num_pose_blocks + l;
+            int offset_l = sparseHessian_.BlockOffset(block_l);
+            int dim_l = sparseHessian_.BlockDim(block_l);
+            auto b_l = schurB_.head(dim_l);
+            b_l = b_.segment(offset_l, dim_l);
+            for (int a = landmarkSlotPtr_[l]; a < landmarkSlotPtr_[l + 1]; ++a)
+            {
+                int pose_p = landmarkPoseSlots_[a].first;
+                auto H_lp = sparseHessian_.SlotBlock(landmarkPoseSlots_[a].second, pose_p);
+                b_l.noalias() -= H_lp * delta_x_.segment(sparseHessian_.BlockOffset(pose_p), H_lp.cols());
+            }
+            delta_x_.segment(offset_l, dim_l).noalias() = H_ll_inv_[l] * b_l;
+        }
+        return true;
+  }
+
+  void Problem::SolvePCG()
+  {
+        ulong size = ordering_generic_;
+
+        // 块 Jacobi 预条件: 每个顶点的对角块 (已经加上了 lambda) 求逆
+        preconditionerValues_.resize(sparseHessian_.NumValues());
+        if (static_cast<int>(blockLDLT_.size()) <= maxLocalDimension_)
+            blockLDLT_.resize(maxLocalDimension_ + 1);
+        for (int blk = 0; blk < sparseHessian_.NumBlocks(); ++blk)
+        {
+            Eigen::LDLT<MatXX> &ldlt = blockLDLT_[sparseHessian_.BlockDim(blk)];
+            auto M_ii = sparseHessian_.Block(blk, blk, preconditionerValues_.data());
+            ldlt.compute(sparseHessian_.Block(blk, blk));
+            M_ii.setIdentity();     // 固定的顶点对角块为 0，保持单位阵
+            if (ldlt.info() == Eigen::Success && ldlt.isPositive())
+                ldlt.solveInPlace(M_ii);
+        }
+        auto ApplyPreconditioner = [&](const VecX &r, VecX &z) {
+            for (int blk = 0; blk < sparseHessian_.NumBlocks(); ++blk)
+            {
+                int offset = sparseHessian_.BlockOffset(blk);
+                int dim = sparseHessian_.BlockDim(blk);
+                z.segment(offset, dim).noalias() =
+                    sparseHessian_.Block(blk, blk, preconditionerValues_.data()) * r.segment(offset, dim);
+            }
+        };
+
+        // inexact Newton: 离最优点越近 (梯度越小) 解得越精确, eta = min(0.5, sqrt(|b| / |b_0|))
+        double b_norm = b_.norm();
+        double eta = std::min(0.5, std::sqrt(b_norm / std::max(initialGradientNorm_, 1e-300)));
+        double tolerance = eta * b_norm;
+
+        // 初值 x = 0, r = b
+        delta_x_.setZero(size);
+        pcgR_ = b_;
+        pcgZ_.resize(size);
+        pcgAp_.resize(size);
+        ApplyPreconditioner(pcgR_, pcgZ_);
+        pcgP_ = pcgZ_;
+        double rz = pcgR_.dot(pcgZ_);
+
+        int max_iterations = static_cast<int>(std::min<ulong>(maxPCGIterations_, size));
+        for (int k = 0; k < max_iterations && pcgR_.norm() > tolerance; ++k)
+        {
+            MultiplyHessian(pcgP_, pcgAp_);
+            double pAp = pcgP_.dot(pcgAp_);
+            if (pAp <= 0)
+                break;
+            double alpha = rz / pAp;
+            delta_x_ += alpha * pcgP_;
+            pcgR_ -= alpha * pcgAp_;
+
+            ApplyPreconditioner(pcgR_, pcgZ_);
+            double rz_new = pcgR_.dot(pcgZ_);
+            pcgP_ = pcgZ_ + (rz_new / rz) * pcgP_;
+            rz = rz_new;
+        }
   }
+
+  void Problem::MultiplyHessian(const VecX &x, VecX &y)
+  {
+        ulong size = ordering_generic_;
+        int num_threads = std::max(1, std::min(numThreads_, static_cast<int>(edgeList_.size())));
+        y.setZero(size);
+        threadProduct_.resize(num_threads - 1);
+        threadJx_.resize(num_threads);
+        threadBlock_.resize(num_threads);
+        for (int t = 0; t < num_threads; ++t)
+        {
+            threadJx_[t].resize(maxResidualDimension_);
+            if (threadBlock_[t].rows() < maxLocalDimension_)
+                threadBlock_[t].resize(maxLocalDimension_, maxLocalDimension_);
+        }
+
+        // 与 MakeHessian 相同的分段和归约顺序
+#ifdef USE_OPENMP
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+#endif
+        for (int t = 0; t < num_threads; ++t)
+        {
+            VecX *y_t = &y;
+            if (t > 0)
+            {
+                threadProduct_[t - 1].setZero(size);
+                y_t = &threadProduct_[t - 1];
+            }
+            size_t begin = edgeList_.size() * t / num_threads;
+            size_t end = edgeList_.size() * (t + 1) / num_threads;
+            for (size_t r = FirstEdgeRun(begin); r < edgeRuns_.size() && edgeRuns_[r].begin < end; ++r)
+            {
+                size_t lo = std::max(begin, edgeRuns_[r].begin), hi = std::min(end, edgeRuns_[r].end);
+                (this->*edgeKernels_[edgeRuns_[r].bucket].multiply)(&edgeList_[lo], hi - lo, x, *y_t, t);
+            }
+        }
+        for (int t = 1; t < num_threads; ++t)
+            y += threadProduct_[t - 1];
+
+        // 先验
+        if (!priorVertices_.empty())
+        {
+            GatherPriorVector(x, priorX_);
+            priorY_.noalias() = H_prior_ * priorX_;
+            for (size_t a = 0; a < priorVertices_.size(); ++a)
+            {
+                const Vertex *v = priorVertices_[a].get();
+                if (v->IsFixed()) continue;
+                y.segment(v->OrderingId(), v->LocalDimension()) += priorY_.segment(priorOffsets_[a], v->LocalDimension());
+            }
+        }
+
+        // LM 的阻尼是算子上的对角平移
+        y += lm_.Lambda() * x;
+  }
+
+  void Problem::MultiplyEdge(const Edge &edge, const VecX &x, VecX &y, int thread)
+  {
+        const auto &verticies = edge.Verticies();
+
+        // J^T (J x)，雅可比已经白化
+        const auto &jacobians = edge.Jacobians();
+        int residual_dim = static_cast<int>(edge.Residual().rows());
+        auto Jx = threadJx_[thread].head(residual_dim);
+        Jx.setZero();
+        for (size_t i = 0; i < verticies.size(); ++i)
+        {
+            const Vertex *v_i = verticies[i].get();
+            if (v_i->IsFixed()) continue;
+            Jx.noalias() += jacobians[i] * x.segment(v_i->OrderingId(), v_i->LocalDimension());
+        }
+        for (size_t i = 0; i < verticies.size(); ++i)
+        {
+            const Vertex *v_i = verticies[i].get();
+            if (v_i->IsFixed()) continue;
+            y.segment(v_i->OrderingId(), v_i->LocalDimension()).noalias() += jacobians[i].transpose() * Jx;
+        }
+  }
+
   void Problem::RemoveLambdaHessianLM()
    {
-    ulong size = Hessian_.cols();
-    assert(Hessian_.rows() == Hessian_.cols() && "Hessian is not square");
-    // TODO:: 这里不应该减去一个，数值的反复加减容易造成数值精度出问题？而应该保存叠加lambda前的值，在这里直接赋值
-    for (ulong i = 0; i < size; ++i) {
-        Hessian_(i, i) -= currentLambda_;
+    if (useSparseHessian_)
+    {
+        sparseHessian_.SetDiagonal(hessianDiagonal_);
+        return;
     }
+    assert(Hessian_.rows() == Hessian_.cols() && "Hessian is not square");
+    Hessian_.diagonal() = hessianDiagonal_;
   }
 
   void Problem::UpdateStates() 
   {
-    for (auto vertex: verticies_) {
-        ulong idx = vertex.second->OrderingId();
-        ulong dim = vertex.second->LocalDimension();
-        VecX delta = delta_x_.segment(idx, dim);
+    // 所有的参数 x 叠加一个增量  x_{k+1} = x_{k} + delta_x
+    // 向量空间上的顶点按段直接在状态向量上相加
+    for (const StateRun &run: stateRuns_)
+        state_.segment(run.state, run.size) += delta_x_.segment(run.delta, run.size);
 
-        // 所有的参数 x 叠加一个增量  x_{k+1} = x_{k} + delta_x
-        vertex.second->Plus(delta);
+    // 流形上的顶点调用各自的 Plus
+    for (Vertex *vertex: manifoldVertices_) {
+        ulong idx = vertex->OrderingId();
+        ulong dim = vertex->LocalDimension();
+        VecX &delta = DeltaBuffer(dim);
+        delta = delta_x_.segment(idx, dim);
+        vertex->Plus(delta);
+    }
+    ++stateEpoch_;
+
+    // 先验的 H 固定在边缘化时的线性化点，b 随状态一阶更新
+    if (!priorVertices_.empty())
+    {
+        bPriorBackup_ = b_prior_;
+        errPriorBackup_ = err_prior_;
+        GatherPriorVector(delta_x_, priorX_);
+        b_prior_.noalias() -= H_prior_ * priorX_;
+        err_prior_.noalias() = -Jt_prior_inv_ * b_prior_;
     }
     }
 
-    void Problem::RollbackStates()
+    void Problem::SaveStates()
     {
-    for (auto vertex: verticies_) 
+        // 所有顶点的参数都在 state_ 中，快照就是一次整体拷贝
+        stateSnapshot_ = state_;
+    }
+
+    void Problem::RollbackStates()
     {
-        ulong idx = vertex.second->OrderingId();
-        ulong dim = vertex.second->LocalDimension();
-        VecX delta = delta_x_.segment(idx, dim);
+    // 之前的增量加了后使得损失函数增加了，我们应该不要这次迭代结果，直接恢复线性化点的状态
+    // 不用 Plus(-delta)，对流形上的顶点 Plus(-delta) 并不是 Plus(delta) 的逆
+    state_ = stateSnapshot_;
+    ++stateEpoch_;
 
-        // 之前的增量加了后使得损失函数增加了，我们应该不要这次迭代结果，所以把之前加上的量减去。
-        vertex.second->Plus(-delta);
+    if (!priorVertices_.empty())
+    {
+        b_prior_ = bPriorBackup_;
+        err_prior_ = errPriorBackup_;
     }
     }
 
-    bool Problem::IsGoodStepInLM() 
+    size_t Problem::AllocatedBytes() const
     {
-    double scale = 0;
-    scale = delta_x_.transpose() * (currentLambda_ * delta_x_ + b_);
-    scale += 1e-3;    // make sure it's non-zero :)
+        // 只统计随问题规模增长的求解缓存，不包括顶点和边自身
+        size_t doubles = Hessian_.size() + sparseHessian_.NumValues() + b_.size() + delta_x_.size() +
+                         hessianDiagonal_.size() + state_.size() + stateSnapshot_.size() +
+                         H_pp_schur_.size() + b_pp_schur_.size() + schurLDLT_.rows() * schurLDLT_.cols() +
+                         schurTemp_.size() + schurB_.size() +
+                         preconditionerValues_.size() + pcgR_.size() + pcgZ_.size() + pcgP_.size() + pcgAp_.size() +
+                         H_prior_.size() + Jt_prior_inv_.size() + 2 * (b_prior_.size() + err_prior_.size());
+        for (auto &H: threadHessian_) doubles += H.size();
+        for (auto &v: threadSparseValues_) doubles += v.size();
+        for (auto &v: threadB_) doubles += v.size();
+        for (auto &v: threadProduct_) doubles += v.size();
+        for (auto &H: H_ll_inv_) doubles += H.size();
 
-    // recompute residuals after update state
-    // 统计所有的残差
-    double tempChi = 0.0;
-    for (auto edge: edges_) 
-    {
-        edge.second->ComputeResidual();
-        tempChi += edge.second->Chi2();
+        // 稀疏矩阵的下标 (int) 以及稀疏分解的因子
+        size_t bytes = doubles * sizeof(double) +
+                       (sparseHessian_.NumValues() + sparseHessian_.Rows() + 1) * sizeof(int);
+        if (useSparseHessian_ && !useSchur_ && !useIterativeSolver_)
+        {
+            bytes += sparseSolver_.matrixL().nestedExpression().nonZeros() * (sizeof(double) + sizeof(int));
+            bytes += sparseUpper_.nonZeros() * (sizeof(double) + 2 * sizeof(int)) + (sparseUpper_.cols() + 1) * sizeof(int);
+        }
+        return bytes;
     }
 
-    double rho = (currentChi_ - tempChi) / scale;
-    if (rho > 0 && isfinite(tempChi))   // last step was good, 误差在下降
+    VecX &Problem::DeltaBuffer(ulong dim)
     {
-        double alpha = 1. - pow((2 * rho - 1), 3);
-        alpha = std::min(alpha, 2. / 3.);
-        double scaleFactor = (std::max)(1. / 3., alpha);
-        currentLambda_ *= scaleFactor;
-        ni_ = 2;
-        currentChi_ = tempChi;
-        return true;
-    } 
-    else
-     {
-        currentLambda_ *= ni_;
-        ni_ *= 2;
-        return false;
+        // 每种维度一个缓存，顶点维度不同时也不会反复分配
+        if (deltaBuffers_.size() <= dim)
+            deltaBuffers_.resize(dim + 1);
+        deltaBuffers_[dim].resize(dim);
+        return deltaBuffers_[dim];
     }
+
+    bool Problem::IsGoodStepInLM() 
+    {
+    // 预测的下降
+    double scale = delta_x_.dot(lm_.Lambda() * delta_x_ + b_);
+
+    // recompute residuals after update state
+    // 统计所有的残差，这一步被接受时 MakeHessian 会直接使用这里的残差
+    TicToc t_residual;
+    trialChi_ = ComputeChi2();
+    summary_.residual_time += t_residual.toc();
+
+    // 误差在下降时接受并减小 lambda，否则加大 lambda
+    return lm_.TryStep(trialChi_, scale);
    }
 
 
@@ -4,10 +4,25 @@
 #include <unordered_map>
 #include <map>
 #include <memory>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <type_traits>
+#include <typeindex>
+#include <typeinfo>
+
+#include <Eigen/Cholesky>
+#include <Eigen/SparseCholesky>
 
 #include "backend/eigen_types.h"
 #include "backend/edge.h"
 #include "backend/vertex.h"
+#include "backend/block_sparse_matrix.h"
+#include "backend/block_ordering.h"
+#include "backend/solver_summary.h"
+#include "backend/lm_control.h"
+#include "backend/object_pool.h"
 
 typedef unsigned long ulong;
 
@@ -16,6 +31,63 @@ namespace myslam
     namespace backend 
     {
 
+    namespace internal
+    {
+        /**
+         * Problem 对边的调用: 注册过的类型用 EdgeType:: 限定名直接调用，不经过虚表，可以内联
+         * EdgeType 为 Edge 时 (未注册的类型) 走虚函数
+         */
+        template <typename EdgeType>
+        struct EdgeCalls
+        {
+            static void ComputeResidual(EdgeType &edge) { edge.EdgeType::ComputeResidual(); }
+            static void ComputeJacobians(EdgeType &edge) { edge.EdgeType::ComputeJacobians(); }
+            static double Chi2(EdgeType &edge) { return edge.EdgeType::Chi2(); }
+            static bool IsFixedSize(const EdgeType &edge) { return edge.EdgeType::IsFixedSize(); }
+            static bool IsStackable(const EdgeType &edge) { return edge.EdgeType::IsStackable(); }
+            static void AddHessianBlock(const EdgeType &edge, int i, int j, HessianBlockRef H_ij)
+            {
+                edge.EdgeType::AddHessianBlock(i, j, H_ij);
+            }
+            static void AddGradientBlock(const EdgeType &edge, int i, GradientBlockRef b_i)
+            {
+                edge.EdgeType::AddGradientBlock(i, b_i);
+            }
+        };
+
+        template <>
+        struct EdgeCalls<Edge>
+        {
+            static void ComputeResidual(Edge &edge) { edge.ComputeResidual(); }
+            static void ComputeJacobians(Edge &edge) { edge.ComputeJacobians(); }
+            static double Chi2(Edge &edge) { return edge.Chi2(); }
+            static bool IsFixedSize(const Edge &edge) { return edge.IsFixedSize(); }
+            static bool IsStackable(const Edge &edge) { return edge.IsStackable(); }
+            static void AddHessianBlock(const Edge &edge, int i, int j, HessianBlockRef H_ij)
+            {
+                edge.AddHessianBlock(i, j, H_ij);
+            }
+            static void AddGradientBlock(const Edge &edge, int i, GradientBlockRef b_i)
+            {
+                edge.AddGradientBlock(i, b_i);
+            }
+        };
+
+        /**
+         * SimplicialLDLT::factorize 每次都把输入拷成一个临时的上三角矩阵 (会分配内存)
+         * 矩阵已经是上三角且不需要重排时，直接对它做数值分解
+         */
+        class UpperSimplicialLDLT
+            : public Eigen::SimplicialLDLT<BlockSparseMatrix::SparseMatrix, Eigen::Upper, Eigen::NaturalOrdering<int>>
+        {
+        public:
+            void FactorizeUpper(const BlockSparseMatrix::SparseMatrix &upper)
+            {
+                this->template factorize_preordered<true>(upper);
+            }
+        };
+    }
+
     class Problem 
     {
     public:
@@ -33,6 +105,36 @@ namespace myslam
         SLAM_PROBLEM,
         GENERIC_PROBLEM
     };
+
+    /**
+     * 线性方程 H dx = b 的求解方式
+     * DENSE:  稠密 H，LDLT 分解，适合维度很小的通用问题
+     * SPARSE: 由顶点-边的连接关系构造块稀疏 H，稀疏 LDLT 分解，耗时随非零块数量增长
+     * AUTO:   通用问题维度较小时用 DENSE，否则用 SPARSE
+     * ITERATIVE: 不构造 H，用边上保存的雅可比计算 (J^T W J + lambda I) x，块 Jacobi 预条件的共轭梯度法求解，
+     *            内存只与边和顶点的数量成正比，适合 H 根本放不下的大问题
+     */
+    enum class LinearSolverType
+    {
+        AUTO,
+        DENSE,
+        SPARSE,
+        ITERATIVE
+    };
+
+    /**
+     * 稀疏分解前对顶点 (块) 的排序，只影响 SPARSE 方式的分解，Schur 补和迭代法不需要
+     * NATURAL: 按顶点 id 的顺序
+     * MINIMUM_DEGREE: 块级的最小度排序，默认
+     * NESTED_DISSECTION: 块级的嵌套剖分，适合网格状或长链加回环的大问题
+     * 排序在拓扑不变时缓存，分解的非零元个数和浮点运算次数记录在 Summary() 中
+     */
+    enum class OrderingType
+    {
+        NATURAL,
+        MINIMUM_DEGREE,
+        NESTED_DISSECTION
+    };
     typedef unsigned long ulong;
 //    typedef std::unordered_map<unsigned long, std::shared_ptr<Vertex>> HashVertex;
     typedef std::map<unsigned long, std::shared_ptr<Vertex>> HashVertex;
@@ -47,6 +149,25 @@ namespace myslam
 
     bool AddVertex(std::shared_ptr<Vertex> vertex);
 
+    /**
+     * 在 Problem 的内存池中创建顶点 / 边，对象和 shared_ptr 的控制块连续存放，删除后的位置会被复用
+     * 创建后仍需 AddVertex / AddEdge；返回的对象可以比 Problem 活得更久
+     * 例如: auto v = problem.NewVertex<VertexPose>(); problem.AddVertex(v);
+     */
+    template <typename VertexType, typename... Args>
+    std::shared_ptr<VertexType> NewVertex(Args &&... args)
+    {
+        static_assert(std::is_base_of<Vertex, VertexType>::value, "VertexType must derive from Vertex");
+        return std::allocate_shared<VertexType>(PoolAllocator<VertexType>(pool_), std::forward<Args>(args)...);
+    }
+
+    template <typename EdgeType, typename... Args>
+    std::shared_ptr<EdgeType> NewEdge(Args &&... args)
+    {
+        static_assert(std::is_base_of<Edge, EdgeType>::value, "EdgeType must derive from Edge");
+        return std::allocate_shared<EdgeType>(PoolAllocator<EdgeType>(pool_), std::forward<Args>(args)...);
+    }
+
     /**
      * remove a vertex
      * @param vertex_to_remove
@@ -57,6 +178,39 @@ namespace myslam
 
     bool RemoveEdge(std::shared_ptr<Edge> edge);
 
+    /**
+     * 为一种边注册专用的计算核
+     * 同一具体类型的边在 edgeList_ 中排在一起，每一段连续的同类边由该类型的核在一个循环中处理
+     * 未注册的类型通过 Edge 的虚函数调用 (同一段内调用目标相同，分支预测总能命中)；
+     * 注册后以 EdgeType:: 限定名直接调用 ComputeResidual / ComputeJacobians / AddHessianBlock 等，可以被内联
+     * 只对具体类型恰好为 EdgeType 的边生效，它的子类仍按未注册处理
+     * 例如: problem.RegisterEdgeType<EdgeReprojectionXYZ>();
+     */
+    template <typename EdgeType>
+    void RegisterEdgeType()
+    {
+        static_assert(std::is_base_of<Edge, EdgeType>::value, "EdgeType must derive from Edge");
+        edgeKernels_[EdgeTypeBucket(typeid(EdgeType))] = EdgeKernel::Of<EdgeType>();
+    }
+
+    /**
+     * 边缘化一组顶点 (通常是滑窗中最老的一帧及只被它观测的路标)
+     * 与这些顶点相连的边在当前状态下线性化，连同已有的先验一起对这些顶点做 Schur 补，
+     * 得到剩余边界顶点上的稠密先验 H_prior_ / b_prior_，然后把顶点和边从问题中删除
+     * 先验的 H 固定在边缘化时的线性化点，之后每次更新状态 b_prior_ -= H_prior_ * dx
+     * 为了与先验保持一致 (First Estimate Jacobian)，之后与先验顶点相连的边的雅可比都在这些顶点
+     * 第一次进入先验时的参数上计算，残差仍在当前状态上计算
+     * @param margVertices 要边缘化的顶点
+     * @return 有顶点不在问题中时返回 false
+     */
+    bool MarginalizeFrame(const std::vector<std::shared_ptr<Vertex>> &margVertices);
+
+    /// 当前先验涉及的顶点
+    const std::vector<std::shared_ptr<Vertex>> &PriorVertices() const { return priorVertices_; }
+
+    /// 问题中的所有顶点，按 id 排序
+    const HashVertex &Vertices() const { return verticies_; }
+
     /**
      * 求解此问题
      * @param iterations
@@ -64,6 +218,49 @@ namespace myslam
      */
     bool Solve(int iterations);
 
+    /// 带截止时间、线性方程求解次数上限和回调的求解，见 SolveOptions
+    bool Solve(const SolveOptions &options);
+
+    /// 设置线性方程求解方式，默认 AUTO
+    void SetLinearSolverType(LinearSolverType type) { linearSolverType_ = type; }
+
+    /// 设置稀疏分解的排序方式，默认 MINIMUM_DEGREE
+    void SetOrderingType(OrderingType type);
+
+    /// 设置构造 H 时使用的线程数，默认 1
+    /// 边被连续地均分给各线程，各线程的 H、b 按固定顺序归约，线程数固定时结果逐位一致
+    void SetNumThreads(int num_threads) { numThreads_ = std::max(1, num_threads); }
+
+    /**
+     * 分组装配，默认关闭
+     * 打开后同类的边再按所连接的顶点排序，连接同一组顶点的连续多条边的白化雅可比堆叠成一个
+     * 高的矩阵，每 kStackRows 行用一次 rankUpdate (SYRK) 和一次 GEMV 得到整组对 H 和 b 的贡献，
+     * 最后每组只向 H 写一次，代替每条边一次小矩阵乘法和一次写入。列数很少时 (例如曲线拟合只有 3 列)
+     * 改用按系数的乘法，此时主要省下的是对 H 的写入；列数较多的动态大小的边收益最大
+     * 求和顺序与逐条边装配不同，结果只在舍入误差内一致。ITERATIVE 方式下的 H x 仍然逐条边计算
+     */
+    void SetGroupedAssembly(bool grouped);
+
+    /// 是否输出每次迭代的信息以及求解结束后的统计，默认不输出
+    void SetVerbose(bool verbose) { verbose_ = verbose; }
+
+    /// 最近一次 Solve 的统计信息: 每次尝试的 chi2 / lambda / 步长，各阶段耗时，问题规模
+    const SolverSummary &Summary() const { return summary_; }
+
+    /// ITERATIVE 方式下每次求解线性方程的最大共轭梯度迭代次数，默认 500
+    void SetMaxPCGIterations(int iterations) { maxPCGIterations_ = std::max(1, iterations); }
+
+    /**
+     * 所有顶点的参数按 ordering 顺序连续存放在一个状态向量中，顶点的 Parameters() 是其中的视图
+     * 可以用来保存和恢复整个问题的状态，例如排查发散的求解时在每次 Solve 前后各存一份
+     * 顶点增删后布局会变，稀疏分解的 Solve 按减少填充的排序重排顶点时布局也会变，只能恢复到布局相同时保存的状态
+     */
+    const VecX &State();
+
+    /// 恢复 State() 保存的状态，长度不一致时返回 false
+    /// 边缘化得到的先验 b_prior_ 不随之恢复
+    bool SetState(const VecX &state);
+
 
 
 private:
@@ -72,17 +269,145 @@ private:
     /// 设置各顶点的ordering_index
     void SetOrdering();
 
+    /// 稀疏分解时按 orderingType_ 重排 vertexList_ 和顶点的 ordering id，并统计分解的规模
+    /// 重排了顶点时返回 true，此时稀疏结构需要重建
+    bool ApplyFillReducingOrdering();
+
+    /// 把顶点参数排列到连续的状态向量 state_ 中，并找出可以合并成一次向量加的顶点段
+    void LayoutStates();
+
+    /// 把顶点参数搬回顶点自己的存储 (只处理绑定在 state_ 上的顶点)
+    void UnbindState(Vertex *vertex);
+
+    /// set ordering for new vertex in slam problem
+    void AddOrderingSLAM(std::shared_ptr<Vertex> v);
+
+    /// 判断一个顶点是否为Pose顶点
+    bool IsPoseVertex(std::shared_ptr<Vertex> v);
+
+    /// 判断一个顶点是否为landmark顶点
+    bool IsLandmarkVertex(std::shared_ptr<Vertex> v);
+
+    /// 由顶点-边的连接关系生成稀疏 H 的块结构，只在拓扑变化后重新生成
+    void MakeHessianStructure();
+
     /// 构造大H矩阵
     void MakeHessian();
 
-    /// 解线性方程
-    void SolveLinearSystem();
+    /// 一种边的计算核，每个函数处理 edgeList_ 中一段连续的 n 条同类边
+    struct EdgeKernel
+    {
+        void (Problem::*linearize)(const std::shared_ptr<Edge> *edges, size_t n,
+                                   MatXX *H, double *sparse_values, VecX &b, int thread);
+        double (Problem::*chi2)(const std::shared_ptr<Edge> *edges, size_t n);
+        void (Problem::*multiply)(const std::shared_ptr<Edge> *edges, size_t n, const VecX &x, VecX &y, int thread);
+
+        template <typename EdgeType>
+        static EdgeKernel Of()
+        {
+            return EdgeKernel{&Problem::LinearizeEdges<EdgeType>, &Problem::EdgesChi2<EdgeType>,
+                              &Problem::MultiplyEdges<EdgeType>};
+        }
+    };
+
+    /// 边的具体类型对应的桶，第一次遇到时新建，计算核默认走虚函数
+    int EdgeTypeBucket(const std::type_info &type);
+
+    /// edgeList_ 中第一段与 [k, ...) 相交的同类边
+    size_t FirstEdgeRun(size_t k) const;
+
+    /// 按所连接顶点的 id 逐个比较，返回 -1 / 0 / 1
+    static int CompareVertexTuples(const Edge &a, const Edge &b);
+
+    /// 同类的两条边在 edgeList_ 中 a 是否排在 b 之前: 分组装配时先比较顶点，再比较 id
+    bool EdgeBefore(const Edge &a, const Edge &b) const;
+
+    /**
+     * 计算边的残差和雅可比并白化，累加到 H (稠密时) 或 sparse_values (稀疏时) 以及 b 中
+     * 分组装配时连接同一组顶点的连续多条边依次堆叠，这组的最后一条边之后整组装配
+     */
+    template <typename EdgeType>
+    void LinearizeEdges(const std::shared_ptr<Edge> *edges, size_t n, MatXX *H, double *sparse_values, VecX &b,
+                        int thread);
+
+    /// 边的 chi2 之和，残差没有算过时先计算
+    template <typename EdgeType>
+    double EdgesChi2(const std::shared_ptr<Edge> *edges, size_t n);
+
+    /// y += (J_e^T W J_e) x 中这些边的贡献
+    template <typename EdgeType>
+    void MultiplyEdges(const std::shared_ptr<Edge> *edges, size_t n, const VecX &x, VecX &y, int thread);
+
+    /// 动态大小的边: 白化后的 J^T J 和 J^T r 累加到 H 和 b 中
+    void AddEdgeToHessian(const Edge &edge, MatXX *H, double *sparse_values, VecX &b);
+
+    /// 分组装配: 白化后的雅可比和残差追加到线程的堆叠缓存中，满 kStackRows 行时先累加到整组的 J^T J
+    void StackEdge(const Edge &edge, int thread);
+
+    /// 把缓存中已经堆叠的行累加到整组的 J^T J 和 J^T r 中
+    void FlushEdgeStack(int thread);
+
+    /// 这组边结束: 整组的 J^T J 和 J^T r 分到 H 和 b 的各个块
+    void AddEdgeStackToHessian(MatXX *H, double *sparse_values, VecX &b, int thread);
+
+    /// 定长边: J^T J 由边自己用定长矩阵计算
+    template <typename EdgeType>
+    void AddFixedEdgeToHessian(const EdgeType &edge, MatXX *H, double *sparse_values, VecX &b);
+
+    /// 当前状态下边的残差，同一个状态版本内只计算一次
+    template <typename EdgeType>
+    void EvaluateResidual(EdgeType &edge)
+    {
+        if (edge.ResidualUpToDate(stateEpoch_))
+            return;
+        internal::EdgeCalls<EdgeType>::ComputeResidual(edge);
+        edge.WhitenResidual();
+        edge.SetResidualEpoch(stateEpoch_);
+    }
+
+    /// 所有边的 chi2 之和，按线程分段求和后再按线程顺序相加
+    double ComputeChi2();
+
+    /// 解线性方程，H + lambda I 分解失败时返回 false，delta_x_ 不可用
+    bool SolveLinearSystem();
+
+    /// SLAM 问题: 用 Schur 补消去 landmark，求解 pose 部分后再回代 landmark
+    /// landmark 对角块或约化后的 pose 部分不正定时返回 false
+    bool SolveSchurSLAM();
+
+    /// ITERATIVE: 块 Jacobi 预条件的共轭梯度法，精度由 inexact Newton 的 forcing term 控制
+    void SolvePCG();
+
+    /// y = (J^T W J + lambda I) x，逐条边计算，不构造 H
+    void MultiplyHessian(const VecX &x, VecX &y);
+
+    /// 动态大小的边: y += J_e^T (J_e x)
+    void MultiplyEdge(const Edge &edge, const VecX &x, VecX &y, int thread);
 
     /// 更新状态变量
     void UpdateStates();
 
+    /// 保存线性化点上所有顶点的参数，回滚时直接拷贝回去
+    void SaveStates();
+
     void RollbackStates(); // 有时候 update 后残差会变大，需要退回去，重来
 
+    /// 先验加到 H 和 b 中 (只加未固定的顶点)
+    void AddPriorToHessian();
+
+    /// 先验中各顶点的增量，按 priorVertices_ 的顺序排列
+    void GatherPriorVector(const VecX &x, VecX &x_prior) const;
+
+    /// first 为 true 时把先验顶点的参数换成第一次估计 (当前值暂存起来)，为 false 时换回当前值
+    /// 只在线性化时临时交换，不改变 stateEpoch_，调用前相关边的残差应已在当前状态上算好
+    void UsePriorFirstEstimates(bool first);
+
+    /// 求解用的各种缓存占用的字节数
+    size_t AllocatedBytes() const;
+
+    /// 返回一个维度为 dim 的增量缓存，更新状态时避免分配临时 VecX
+    VecX &DeltaBuffer(ulong dim);
+
     /// Levenberg
     /// 计算LM算法的初始Lambda
     void ComputeLambdaInitLM();
@@ -96,23 +421,117 @@ private:
     bool IsGoodStepInLM();
 ;
 
-    double currentLambda_;
-    double currentChi_;//迭代次数
-    double stopThresholdLM_;    // LM 迭代退出阈值条件
-    double ni_;                 //控制 Lambda 缩放大小
+    internal::LMControl lm_;    // lambda、当前 chi2 以及停止条件
+    double trialChi_ = 0.;      // 最近一次尝试后的 chi2
 
     ProblemType problemType_;
 
-    /// 整个信息矩阵
+    LinearSolverType linearSolverType_ = LinearSolverType::AUTO;
+    bool useSparseHessian_ = false;     // 本次求解实际是否使用稀疏 H
+    bool topologyChanged_ = true;       // 增删顶点以及非零块变化后需要重新生成稀疏结构
+    bool orderingValid_ = false;        // 增删顶点后需要重新计算 ordering
+
+    /// 整个信息矩阵, 稠密方式使用 Hessian_, 稀疏方式使用 sparseHessian_
     MatXX Hessian_;
+    BlockSparseMatrix sparseHessian_;
+    Eigen::LDLT<MatXX> denseSolver_;
+
+    /// LM 阻尼相关: 不含 lambda 的对角线
+    VecX hessianDiagonal_;
+
+    /// 所有顶点参数按 vertexList_ 顺序连续存放，顶点的 Parameters() 指向这里
+    /// stateOffsets_[k] 为 vertexList_[k] 的参数在 state_ 中的起点
+    VecX state_;
+    std::vector<ulong> stateOffsets_;
+    bool stateLayoutValid_ = false;
+
+    /// 连续的向量空间顶点段: state_ 中 [state, state+size) 与 delta_x_ 中 [delta, delta+size) 一一对应
+    struct StateRun
+    {
+        ulong state;
+        ulong delta;
+        ulong size;
+    };
+    std::vector<StateRun> stateRuns_;
+    std::vector<Vertex *> manifoldVertices_;    // 需要调用 Plus 的顶点
+
+    /// 线性化点上所有顶点参数的快照，与 state_ 布局相同
+    VecX stateSnapshot_;
+
+    /// 顶点状态的版本号，UpdateStates / RollbackStates 以及每次 Solve 开始时加一
+    unsigned long stateEpoch_ = 0;
+    /// 排序已经由 ApplyFillReducingOrdering 在块上完成，分解时不再重排
+    internal::UpperSimplicialLDLT sparseSolver_;
+    /// sparseHessian_ 只存下三角，分解前按 upperValueIndex_ 把数值搬到上三角的 sparseUpper_ 中
+    BlockSparseMatrix::SparseMatrix sparseUpper_;
+    std::vector<int> upperValueIndex_;
     VecX b_;
     VecX delta_x_;
 
+    /// SLAM 问题中 Schur 补之后的 pose 部分
+    MatXX H_pp_schur_;
+    VecX b_pp_schur_;
+    Eigen::LDLT<MatXX> schurLDLT_;
+    std::vector<MatXX, Eigen::aligned_allocator<MatXX>> H_ll_inv_;    // 每个 landmark 对角块的逆
+    MatXX schurTemp_;                   // Hpl * Hll^-1 的缓存
+    VecX schurB_;
+    /// 对角块的分解 (landmark 块求逆、PCG 的预条件)，按块的维度各一个，维度不变时不重新分配
+    std::vector<Eigen::LDLT<MatXX>> blockLDLT_;
+    /// landmark 与 pose 之间的非零块: 第 l 个 landmark 的块为 landmarkPoseSlots_[landmarkSlotPtr_[l] .. landmarkSlotPtr_[l+1])
+    /// 每一项为 (pose 块号, 稀疏 H 中的块编号)
+    std::vector<int> landmarkSlotPtr_;
+    std::vector<std::pair<int, int>> landmarkPoseSlots_;
+    bool useSchur_ = false;             // landmark 之间没有约束时才能用 Schur 补
+
+    /// ITERATIVE 方式: sparseHessian_ 只保存对角块 (预条件和 lambda 用)，不构造完整的 H
+    bool useIterativeSolver_ = false;
+    bool structureIterative_ = false;   // 当前的稀疏结构是否为只有对角块的结构
+
+    /// 稀疏分解的排序，拓扑变化或顶点增删后重新计算
+    OrderingType orderingType_ = OrderingType::MINIMUM_DEGREE;
+    bool fillOrderingValid_ = false;
+    bool fillOrderingPermuted_ = false;     // vertexList_ 是否已经不是自然顺序
+    long factorNonZeros_ = 0;
+    double factorFlops_ = 0.;
+    int maxPCGIterations_ = 500;
+    double initialGradientNorm_ = 0.;   // 第一个线性化点上 |b|，用于计算 forcing term
+    VecX preconditionerValues_;         // 对角块的逆，布局与 sparseHessian_.Values() 相同
+    VecX pcgR_, pcgZ_, pcgP_, pcgAp_;
+    std::vector<VecX> threadProduct_;   // 线程 1..n-1 的 H x 累加器
+    std::vector<VecX> threadJx_;        // 每个线程的 J x 缓存
+    std::vector<MatXX> threadBlock_;    // 每个线程的 H_ij 缓存，定长边用
+
+    /// 分组装配: 每次 rankUpdate 堆叠的最多行数，以及每个线程的堆叠缓存
+    /// 列数不超过 kNarrowStackCols 时用按系数的乘法代替 rankUpdate
+    static const int kStackRows = 256;
+    static const int kNarrowStackCols = 8;
+    struct EdgeStack
+    {
+        const std::vector<std::shared_ptr<Vertex>> *verticies = nullptr;   // 当前这组边的顶点，没有时为空
+        int cols = 0;   // 非固定顶点的维数之和
+        int rows = 0;   // J 中还没有累加的行数
+        MatXX J;        // 堆叠的雅可比，列为各个非固定顶点依次排列
+        VecX r;
+        MatXX JtJ;      // 整组的 J^T J，用 rankUpdate 时只写下三角
+        VecX Jtr;
+    };
+    bool groupedAssembly_ = false;
+    std::vector<EdgeStack> threadStack_;
+
     /// 先验部分信息
+    /// H_prior_ = J^T J, b_prior_ = -J^T err, err_prior_ = -Jt_prior_inv_ * b_prior_，按 priorVertices_ 的顺序排列
     MatXX H_prior_;
     VecX b_prior_;
     MatXX Jt_prior_inv_;
     VecX err_prior_;
+    std::vector<std::shared_ptr<Vertex>> priorVertices_;
+    std::vector<int> priorOffsets_;     // 每个先验顶点在 H_prior_ 中的起始位置
+    std::vector<VecX> priorFirstEstimates_;     // 先验顶点第一次进入先验时的参数 (FEJ 的线性化点)
+    std::vector<VecX> priorCurrentEstimates_;   // 线性化时暂存先验顶点的当前参数
+    VecX bPriorBackup_;                 // 回滚时恢复
+    VecX errPriorBackup_;
+    VecX priorX_;                       // 先验维度的缓存
+    VecX priorY_;
 
   
 
@@ -122,6 +541,48 @@ private:
     /// all edges
     HashEdge edges_;
 
+    /// 顶点和边的内存池，见 NewVertex / NewEdge
+    std::shared_ptr<ObjectPool> pool_;
+
+    /// 按 ordering 顺序排列的所有顶点，位置即顶点的稠密下标，增删顶点后在 SetOrdering 中重建
+    /// 每次迭代中对顶点的遍历 (更新、快照、回滚) 都是对这个数组的顺序扫描
+    std::vector<Vertex *> vertexList_;
+
+    /// 按 (具体类型, id) 排序的所有边，同类的边连续存放，构造 H 时按这个顺序分给各线程
+    /// 类型之间按 std::type_index 排序，与加入的先后无关，同样的边集合总是得到同样的顺序
+    /// 边的 OrderingId() 是它在这里的位置，删除的边先留下空位，SetOrdering 时再压缩
+    std::vector<std::shared_ptr<Edge>> edgeList_;
+    std::vector<int> edgeListBuckets_;      // edgeList_ 中每条边的类型桶
+    bool edgeListHoles_ = false;
+    bool edgeListSorted_ = true;
+
+    /// 边的类型桶及其计算核，见 RegisterEdgeType
+    std::unordered_map<std::type_index, int> edgeTypeBuckets_;
+    std::vector<std::type_index> edgeBucketTypes_;
+    std::vector<EdgeKernel> edgeKernels_;
+
+    /// edgeList_ 中一段连续的同类边 [begin, end)，增删边后在 SetOrdering 中重建
+    struct EdgeRun
+    {
+        size_t begin, end;
+        int bucket;
+    };
+    std::vector<EdgeRun> edgeRuns_;
+    bool edgeRunsValid_ = false;
+
+    /// 顶点对 (小 id, 大 id) 之间的边数，即稀疏 H 的非零块，增删边时维护
+    static std::pair<ulong, ulong> VertexPair(ulong a, ulong b) { return a < b ? std::make_pair(a, b) : std::make_pair(b, a); }
+    std::map<std::pair<ulong, ulong>, int> blockPairCount_;
+    int numThreads_ = 1;
+    /// 线程 1..n-1 私有的 H、b 累加器
+    std::vector<MatXX> threadHessian_;
+    std::vector<VecX> threadSparseValues_;
+    std::vector<VecX> threadB_;
+    std::vector<double> threadChi2_;    // 每个线程的 chi2 部分和
+    int maxResidualDimension_ = 0;
+    int maxLocalDimension_ = 0;
+    std::vector<VecX> deltaBuffers_;    // 按维度索引的增量缓存
+
     /// 由vertex id查询edge
     HashVertexIdToEdge vertexToEdge_;
 
@@ -129,13 +590,133 @@ private:
     ulong ordering_poses_ = 0;
     ulong ordering_landmarks_ = 0;
     ulong ordering_generic_ = 0;
+    std::map<unsigned long, std::shared_ptr<Vertex>> idx_pose_vertices_;        // 以ordering排序的pose顶点
+    std::map<unsigned long, std::shared_ptr<Vertex>> idx_landmark_vertices_;    // 以ordering排序的landmark顶点
 
      // verticies need to marg. <Ordering_id_, Vertex>
     HashVertex verticies_marg_;
     
-     double t_hessian_cost_ = 0.0;
+    bool verbose_ = false;
+    SolverSummary summary_;
 };
 
+    template <typename EdgeType>
+    void Problem::LinearizeEdges(const std::shared_ptr<Edge> *edges, size_t n,
+                                 MatXX *H, double *sparse_values, VecX &b, int thread)
+    {
+        typedef internal::EdgeCalls<EdgeType> Calls;
+        for (size_t k = 0; k < n; ++k)
+        {
+            EdgeType &edge = static_cast<EdgeType &>(*edges[k]);
+            // 刚被接受的一步在 IsGoodStepInLM 中已经算过残差
+            EvaluateResidual(edge);
+            Calls::ComputeJacobians(edge);
+            edge.WhitenJacobians();
+            if (groupedAssembly_ && Calls::IsStackable(edge))
+            {
+                // 下一条边连接同样的顶点时先堆叠起来，这组的最后一条边之后整组装配
+                bool more = k + 1 < n && edges[k + 1]->Verticies() == edge.Verticies();
+                if (more || threadStack_[thread].verticies)
+                {
+                    StackEdge(edge, thread);
+                    if (!more)
+                        AddEdgeStackToHessian(H, sparse_values, b, thread);
+                    continue;
+                }
+            }
+            if (Calls::IsFixedSize(edge))
+                AddFixedEdgeToHessian(edge, H, sparse_values, b);
+            else
+                AddEdgeToHessian(edge, H, sparse_values, b);
+        }
+    }
+
+    template <typename EdgeType>
+    double Problem::EdgesChi2(const std::shared_ptr<Edge> *edges, size_t n)
+    {
+        double chi2 = 0.;
+        for (size_t k = 0; k < n; ++k)
+        {
+            EdgeType &edge = static_cast<EdgeType &>(*edges[k]);
+            EvaluateResidual(edge);
+            chi2 += internal::EdgeCalls<EdgeType>::Chi2(edge);
+        }
+        return chi2;
+    }
+
+    template <typename EdgeType>
+    void Problem::AddFixedEdgeToHessian(const EdgeType &edge, MatXX *H, double *sparse_values, VecX &b)
+    {
+        // 定长边自己计算每个块，结果直接写到目标块中
+        typedef internal::EdgeCalls<EdgeType> Calls;
+        const auto &verticies = edge.Verticies();
+        for (size_t i = 0; i < verticies.size(); ++i)
+        {
+            const Vertex *v_i = verticies[i].get();
+            if (v_i->IsFixed()) continue;
+            ulong index_i = v_i->OrderingId();
+            ulong dim_i = v_i->LocalDimension();
+
+            for (size_t j = i; j < verticies.size(); ++j)
+            {
+                const Vertex *v_j = verticies[j].get();
+                if (v_j->IsFixed()) continue;
+                if (useIterativeSolver_ && j != i) continue;
+                ulong index_j = v_j->OrderingId();
+                ulong dim_j = v_j->LocalDimension();
+
+                if (useSparseHessian_)
+                {
+                    int block_i = sparseHessian_.BlockIndex(index_i);
+                    int block_j = sparseHessian_.BlockIndex(index_j);
+                    if (block_i >= block_j)
+                        Calls::AddHessianBlock(edge, i, j, sparseHessian_.Block(block_i, block_j, sparse_values));
+                    else
+                        Calls::AddHessianBlock(edge, j, i, sparseHessian_.Block(block_j, block_i, sparse_values));
+                    continue;
+                }
+                Calls::AddHessianBlock(edge, i, j, H->block(index_i, index_j, dim_i, dim_j));
+                if (j != i)
+                    Calls::AddHessianBlock(edge, j, i, H->block(index_j, index_i, dim_j, dim_i));
+            }
+            Calls::AddGradientBlock(edge, i, b.segment(index_i, dim_i));
+        }
+    }
+
+    template <typename EdgeType>
+    void Problem::MultiplyEdges(const std::shared_ptr<Edge> *edges, size_t n, const VecX &x, VecX &y, int thread)
+    {
+        typedef internal::EdgeCalls<EdgeType> Calls;
+        MatXX &H_ij = threadBlock_[thread];
+        for (size_t k = 0; k < n; ++k)
+        {
+            const EdgeType &edge = static_cast<const EdgeType &>(*edges[k]);
+            if (!Calls::IsFixedSize(edge))
+            {
+                MultiplyEdge(edge, x, y, thread);
+                continue;
+            }
+
+            // 定长边 (包括批量边) 不一定保存了逐个观测的雅可比，用它自己算的 H_ij 块
+            const auto &verticies = edge.Verticies();
+            for (size_t i = 0; i < verticies.size(); ++i)
+            {
+                const Vertex *v_i = verticies[i].get();
+                if (v_i->IsFixed()) continue;
+                for (size_t j = 0; j < verticies.size(); ++j)
+                {
+                    const Vertex *v_j = verticies[j].get();
+                    if (v_j->IsFixed()) continue;
+                    auto block = H_ij.topLeftCorner(v_i->LocalDimension(), v_j->LocalDimension());
+                    block.setZero();
+                    Calls::AddHessianBlock(edge, i, j, block);
+                    y.segment(v_i->OrderingId(), v_i->LocalDimension()).noalias() +=
+                        block * x.segment(v_j->OrderingId(), v_j->LocalDimension());
+                }
+            }
+        }
+    }
+
 }
 }
 
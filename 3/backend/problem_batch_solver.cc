@@ -0,0 +1,120 @@
+#include "backend/problem_batch_solver.h"
+
+namespace myslam
+{
+    namespace backend
+    {
+
+    ProblemBatchSolver::ProblemBatchSolver(int num_threads) : remaining_(0)
+    {
+        if (num_threads <= 0)
+            num_threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+        for (int i = 0; i < num_threads; ++i)
+            queues_.emplace_back(new TaskQueue());
+        for (int i = 0; i < num_threads; ++i)
+            threads_.emplace_back(&ProblemBatchSolver::WorkerLoop, this, i);
+    }
+
+    ProblemBatchSolver::~ProblemBatchSolver()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto &thread: threads_)
+            thread.join();
+    }
+
+    const std::vector<ProblemBatchSolver::Result> &ProblemBatchSolver::Solve(const std::vector<Problem *> &problems,
+                                                                            int iterations)
+    {
+        results_.assign(problems.size(), Result());
+        if (problems.empty())
+            return results_;
+
+        problems_ = &problems;
+        iterations_ = iterations;
+        remaining_ = problems.size();
+
+        // 问题按顺序连续地分给各线程，相邻的问题往往规模相近
+        size_t num_threads = queues_.size();
+        for (size_t t = 0; t < num_threads; ++t)
+        {
+            std::lock_guard<std::mutex> lock(queues_[t]->mutex);
+            size_t begin = problems.size() * t / num_threads;
+            size_t end = problems.size() * (t + 1) / num_threads;
+            for (size_t k = begin; k < end; ++k)
+                queues_[t]->tasks.push_back(k);
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        ++generation_;
+        wake_.notify_all();
+        done_.wait(lock, [this] { return remaining_ == 0; });
+        problems_ = nullptr;
+        return results_;
+    }
+
+    void ProblemBatchSolver::WorkerLoop(int worker)
+    {
+        unsigned long seen_generation = 0;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&] { return stop_ || generation_ != seen_generation; });
+                if (stop_)
+                    return;
+                seen_generation = generation_;
+            }
+
+            size_t task;
+            while (PopTask(worker, task))
+            {
+                Problem *problem = (*problems_)[task];
+                Result &result = results_[task];
+                result.success = problem->Solve(iterations_);
+                result.summary = problem->Summary();
+
+                // 最后一个任务完成时通知 Solve
+                if (--remaining_ == 0)
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    done_.notify_all();
+                }
+            }
+        }
+    }
+
+    bool ProblemBatchSolver::PopTask(int worker, size_t &task)
+    {
+        {
+            TaskQueue &own = *queues_[worker];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty())
+            {
+                task = own.tasks.front();
+                own.tasks.pop_front();
+                return true;
+            }
+        }
+
+        int num_queues = static_cast<int>(queues_.size());
+        for (int k = 1; k < num_queues; ++k)
+        {
+            TaskQueue &victim = *queues_[(worker + k) % num_queues];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty())
+            {
+                task = victim.tasks.back();
+                victim.tasks.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    }
+}
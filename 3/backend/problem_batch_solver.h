@@ -0,0 +1,89 @@
+#ifndef MYSLAM_BACKEND_PROBLEM_BATCH_SOLVER_H
+#define MYSLAM_BACKEND_PROBLEM_BATCH_SOLVER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "backend/problem.h"
+#include "backend/solver_summary.h"
+
+namespace myslam
+{
+    namespace backend
+    {
+
+    /**
+     * 并行求解多个相互独立的 Problem，例如每个 IMU 轴一个的标定问题
+     * 线程池在构造时创建，各线程有自己的任务队列，自己的队列空了之后从别的线程的队列尾部偷任务，
+     * 问题的规模相差很大时也能保持各线程都有事做
+     *
+     * 不同的 Problem 之间不能共享顶点和边；每个 Problem 内部最好用单线程 (SetNumThreads(1))，
+     * 并行放在问题之间
+     */
+    class ProblemBatchSolver
+    {
+    public:
+        /// 每个问题的求解结果
+        struct Result
+        {
+            bool success = false;
+            SolverSummary summary;
+        };
+
+        /// num_threads <= 0 时使用硬件线程数
+        explicit ProblemBatchSolver(int num_threads = 0);
+        ~ProblemBatchSolver();
+
+        ProblemBatchSolver(const ProblemBatchSolver &) = delete;
+        ProblemBatchSolver &operator=(const ProblemBatchSolver &) = delete;
+
+        /**
+         * 对每个问题调用 Solve(iterations)，全部完成后返回
+         * @return 与 problems 一一对应的结果，也可以之后通过 Results() 取得
+         */
+        const std::vector<Result> &Solve(const std::vector<Problem *> &problems, int iterations);
+
+        /// 最近一次 Solve 的结果
+        const std::vector<Result> &Results() const { return results_; }
+
+        int NumThreads() const { return static_cast<int>(threads_.size()); }
+
+    private:
+        /// 一个线程的任务队列: 自己从头部取，别的线程从尾部偷
+        struct TaskQueue
+        {
+            std::mutex mutex;
+            std::deque<size_t> tasks;
+        };
+
+        void WorkerLoop(int worker);
+
+        /// 先取自己队列中的任务，没有的话依次从其他队列偷
+        bool PopTask(int worker, size_t &task);
+
+        std::vector<std::thread> threads_;
+        std::vector<std::unique_ptr<TaskQueue>> queues_;
+
+        /// 唤醒线程以及等待一批任务完成
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        std::condition_variable done_;
+        unsigned long generation_ = 0;      // 每批任务加一，线程据此判断是否有新任务
+        bool stop_ = false;
+        std::atomic<size_t> remaining_;
+
+        /// 当前这批任务，只在各线程空闲时由 Solve 修改
+        const std::vector<Problem *> *problems_ = nullptr;
+        int iterations_ = 0;
+        std::vector<Result> results_;
+    };
+
+    }
+}
+
+#endif
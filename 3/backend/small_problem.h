@@ -0,0 +1,424 @@
+#ifndef MYSLAM_BACKEND_SMALL_PROBLEM_H
+#define MYSLAM_BACKEND_SMALL_PROBLEM_H
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "backend/eigen_types.h"
+#include "backend/edge.h"
+#include "backend/vertex.h"
+#include "backend/problem.h"
+#include "backend/solver_summary.h"
+#include "utils/tic_toc.h"
+
+namespace myslam
+{
+    namespace backend
+    {
+
+    /// SmallProblem 的维度上限，更大的问题用 Problem
+    const int kMaxSmallProblemDimension = 32;
+
+    namespace internal
+    {
+        /**
+         * 定长对称正定矩阵的原地 LDLT 分解 (不选主元)，只读下三角
+         * 分解后严格下三角为 L (对角线为 1)，对角线为 D；循环上界都是编译期常数，小维度时可以完全展开
+         * @return 出现非正的主元 (矩阵不正定) 时返回 false
+         */
+        template <int Dim>
+        bool FactorizeLDLT(Eigen::Matrix<double, Dim, Dim> &A)
+        {
+            double ld[Dim] = {};    // 第 j 行的 L_jk D_k
+            for (int j = 0; j < Dim; ++j)
+            {
+                double d = A(j, j);
+                for (int k = 0; k < j; ++k)
+                {
+                    ld[k] = A(j, k) * A(k, k);
+                    d -= A(j, k) * ld[k];
+                }
+                if (!(d > 0.))
+                    return false;
+                A(j, j) = d;
+                for (int i = j + 1; i < Dim; ++i)
+                {
+                    double s = A(i, j);
+                    for (int k = 0; k < j; ++k)
+                        s -= A(i, k) * ld[k];
+                    A(i, j) = s / d;
+                }
+            }
+            return true;
+        }
+
+        /// 用 FactorizeLDLT 的结果原地解 L D L^T x = b
+        template <int Dim>
+        void SolveLDLT(const Eigen::Matrix<double, Dim, Dim> &LD, Eigen::Matrix<double, Dim, 1> &x)
+        {
+            for (int i = 0; i < Dim; ++i)
+                for (int k = 0; k < i; ++k)
+                    x(i) -= LD(i, k) * x(k);
+            for (int i = 0; i < Dim; ++i)
+                x(i) /= LD(i, i);
+            for (int i = Dim - 1; i >= 0; --i)
+                for (int k = i + 1; k < Dim; ++k)
+                    x(i) -= LD(k, i) * x(k);
+        }
+    }
+
+    /**
+     * 总的本地维度在编译期已知并且很小 (不超过 kMaxSmallProblemDimension) 的问题，例如按轴的 IMU 尺度和零偏拟合
+     * 接口与 Problem 相同 (AddVertex / AddEdge / Solve / Summary)，顶点和边的类也相同，可以直接替换 Problem
+     * H 和 b 是定长的成员，线性方程用定长的 LDLT 求解，没有排序、哈希表和动态大小的矩阵；
+     * 容量预留好之后 (同一个对象重复 Clear 和求解) 求解过程中不分配内存
+     * 阻尼、步长的接受与拒绝以及停止条件与 Problem::Solve 共用 internal::LMControl，结果只在舍入误差内一致
+     * Summary() 中只统计总耗时和每次尝试的时间，不分阶段计时 (计时本身的开销与小问题的一次迭代相当)
+     *
+     * @tparam Dim 所有未固定顶点的本地维度之和，Solve 时检查
+     * @tparam EdgeType 所有边的具体类型，给出时直接调用 EdgeType:: 的函数而不经过虚表 (同 Problem::RegisterEdgeType)，
+     *                  默认的 Edge 可以混合各种边
+     *
+     * 不支持边缘化和先验；顶点和边不能同时属于正在求解的 Problem
+     * 例如: SmallProblem<3, CurveFittingEdge> problem; problem.AddVertex(v); problem.AddEdge(e); problem.Solve(10);
+     */
+    template <int Dim, typename EdgeType = Edge>
+    class SmallProblem
+    {
+        static_assert(Dim > 0 && Dim <= kMaxSmallProblemDimension, "SmallProblem is for dimensions up to 32");
+        static_assert(std::is_base_of<Edge, EdgeType>::value, "EdgeType must derive from Edge");
+
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+
+        typedef Eigen::Matrix<double, Dim, Dim> MatrixType;
+        typedef Eigen::Matrix<double, Dim, 1> VectorType;
+
+        /// 参数维度 (流形上的顶点大于本地维度) 之和的上限
+        static const int kMaxParameters = 2 * Dim;
+
+        bool AddVertex(std::shared_ptr<Vertex> vertex)
+        {
+            verticies_.push_back(vertex);
+            return true;
+        }
+
+        bool AddEdge(std::shared_ptr<EdgeType> edge)
+        {
+            edges_.push_back(edge);
+            return true;
+        }
+
+        /// 预留边的容量
+        void Reserve(size_t num_edges) { edges_.reserve(num_edges); }
+
+        /// 去掉所有顶点和边，保留容量，用同一个对象求解下一个问题
+        void Clear()
+        {
+            verticies_.clear();
+            edges_.clear();
+        }
+
+        bool Solve(int iterations)
+        {
+            SolveOptions options;
+            options.max_iterations = iterations;
+            return Solve(options);
+        }
+
+        /// 与 Problem::Solve(const SolveOptions &) 的停止条件相同
+        bool Solve(const SolveOptions &options);
+
+        void SetVerbose(bool verbose) { verbose_ = verbose; }
+
+        const SolverSummary &Summary() const { return summary_; }
+
+    private:
+        typedef internal::EdgeCalls<EdgeType> Calls;
+
+        /// 给未固定的顶点分配在 H 中的位置，维度之和不等于 Dim 时返回 false
+        bool SetOrdering();
+
+        /// 构造 H 和 b，residuals_ready 时各边的残差已经是当前状态下的
+        void MakeHessian(bool residuals_ready);
+
+        /// 计算所有边的残差和 chi2
+        double ComputeChi2();
+
+        /// 解 (H + lambda I) dx = b，不正定时返回 false
+        bool SolveLinearSystem();
+
+        void UpdateStates();
+        void SaveStates();
+        void RollbackStates();
+
+        std::vector<std::shared_ptr<Vertex>> verticies_;
+        std::vector<std::shared_ptr<EdgeType>> edges_;
+        std::vector<Vertex *> freeVerticies_;   // 未固定的顶点，按在 H 中的顺序
+        int numParameters_ = 0;
+
+        MatrixType Hessian_;
+        VectorType b_;
+        VectorType hessianDiagonal_;
+        MatrixType factor_;
+        VectorType delta_x_;
+        Eigen::Matrix<double, kMaxParameters, 1> stateSnapshot_;
+        std::vector<VecX> deltaBuffers_;        // 流形上的顶点 Plus 用，每种维度一个
+
+        internal::LMControl lm_;
+        double trialChi_ = 0.;
+
+        SolverSummary summary_;
+        bool verbose_ = false;
+    };
+
+    template <int Dim, typename EdgeType>
+    bool SmallProblem<Dim, EdgeType>::SetOrdering()
+    {
+        freeVerticies_.clear();
+        int local = 0;
+        numParameters_ = 0;
+        for (auto &vertex: verticies_)
+        {
+            if (vertex->IsFixed())
+                continue;
+            vertex->SetOrderingId(local);
+            local += vertex->LocalDimension();
+            numParameters_ += vertex->Dimension();
+            freeVerticies_.push_back(vertex.get());
+        }
+        if (local != Dim || numParameters_ > kMaxParameters)
+        {
+            std::cerr << " SmallProblem<" << Dim << ">: free verticies have local dimension " << local
+                      << " and " << numParameters_ << " parameters" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    template <int Dim, typename EdgeType>
+    void SmallProblem<Dim, EdgeType>::MakeHessian(bool residuals_ready)
+    {
+        Hessian_.setZero();
+        b_.setZero();
+        for (auto &pointer: edges_)
+        {
+            EdgeType &edge = *pointer;
+            if (!residuals_ready)
+            {
+                Calls::ComputeResidual(edge);
+                edge.WhitenResidual();
+            }
+            Calls::ComputeJacobians(edge);
+            edge.WhitenJacobians();
+
+            // 与 Problem 相同: 定长边自己计算每个块，其他边用动态大小的雅可比
+            const bool fixed_size = Calls::IsFixedSize(edge);
+            const auto &verticies = edge.Verticies();
+            for (size_t i = 0; i < verticies.size(); ++i)
+            {
+                const Vertex *v_i = verticies[i].get();
+                if (v_i->IsFixed()) continue;
+                int index_i = v_i->OrderingId();
+                int dim_i = v_i->LocalDimension();
+                for (size_t j = i; j < verticies.size(); ++j)
+                {
+                    const Vertex *v_j = verticies[j].get();
+                    if (v_j->IsFixed()) continue;
+                    int index_j = v_j->OrderingId();
+                    int dim_j = v_j->LocalDimension();
+                    if (fixed_size)
+                    {
+                        Calls::AddHessianBlock(edge, i, j, Hessian_.block(index_i, index_j, dim_i, dim_j));
+                        if (j != i)
+                            Calls::AddHessianBlock(edge, j, i, Hessian_.block(index_j, index_i, dim_j, dim_i));
+                        continue;
+                    }
+                    const MatXX &jacobian_i = edge.Jacobians()[i];
+                    const MatXX &jacobian_j = edge.Jacobians()[j];
+                    Hessian_.block(index_i, index_j, dim_i, dim_j).noalias() += jacobian_i.transpose() * jacobian_j;
+                    if (j != i)
+                        Hessian_.block(index_j, index_i, dim_j, dim_i).noalias() += jacobian_j.transpose() * jacobian_i;
+                }
+                if (fixed_size)
+                    Calls::AddGradientBlock(edge, i, b_.segment(index_i, dim_i));
+                else
+                    b_.segment(index_i, dim_i).noalias() -= edge.Jacobians()[i].transpose() * edge.Residual();
+            }
+        }
+        hessianDiagonal_ = Hessian_.diagonal();
+    }
+
+    template <int Dim, typename EdgeType>
+    double SmallProblem<Dim, EdgeType>::ComputeChi2()
+    {
+        double chi2 = 0.;
+        for (auto &pointer: edges_)
+        {
+            EdgeType &edge = *pointer;
+            Calls::ComputeResidual(edge);
+            edge.WhitenResidual();
+            chi2 += Calls::Chi2(edge);
+        }
+        return chi2;
+    }
+
+    template <int Dim, typename EdgeType>
+    bool SmallProblem<Dim, EdgeType>::SolveLinearSystem()
+    {
+        // 只有下三角参与分解
+        factor_.template triangularView<Eigen::Lower>() = Hessian_;
+        factor_.diagonal() = hessianDiagonal_.array() + lm_.Lambda();
+        bool ok = internal::FactorizeLDLT<Dim>(factor_);
+        if (ok)
+        {
+            delta_x_ = b_;
+            internal::SolveLDLT<Dim>(factor_, delta_x_);
+        }
+        return ok;
+    }
+
+    template <int Dim, typename EdgeType>
+    void SmallProblem<Dim, EdgeType>::UpdateStates()
+    {
+        for (Vertex *vertex: freeVerticies_)
+        {
+            int index = vertex->OrderingId();
+            int dim = vertex->LocalDimension();
+            if (vertex->IsVectorSpace())
+            {
+                vertex->Parameters() += delta_x_.segment(index, dim);
+                continue;
+            }
+            if (static_cast<int>(deltaBuffers_.size()) <= dim)
+                deltaBuffers_.resize(dim + 1);
+            VecX &delta = deltaBuffers_[dim];
+            delta = delta_x_.segment(index, dim);
+            vertex->Plus(delta);
+        }
+    }
+
+    template <int Dim, typename EdgeType>
+    void SmallProblem<Dim, EdgeType>::SaveStates()
+    {
+        int offset = 0;
+        for (Vertex *vertex: freeVerticies_)
+        {
+            stateSnapshot_.segment(offset, vertex->Dimension()) = vertex->Parameters();
+            offset += vertex->Dimension();
+        }
+    }
+
+    template <int Dim, typename EdgeType>
+    void SmallProblem<Dim, EdgeType>::RollbackStates()
+    {
+        int offset = 0;
+        for (Vertex *vertex: freeVerticies_)
+        {
+            vertex->Parameters() = stateSnapshot_.segment(offset, vertex->Dimension());
+            offset += vertex->Dimension();
+        }
+    }
+
+    template <int Dim, typename EdgeType>
+    bool SmallProblem<Dim, EdgeType>::Solve(const SolveOptions &options)
+    {
+        summary_.Reset();
+        if (edges_.empty() || verticies_.empty())
+        {
+            std::cerr << " cannot solve problem without edges or verticies" << std::endl;
+            return false;
+        }
+        if (!SetOrdering())
+            return false;
+
+        TicToc t_solve;
+        MakeHessian(false);
+        double linearize_cost = t_solve.toc();
+        SaveStates();
+
+        // LM 初始化以及之后 lambda 的更新和停止条件都与 Problem::Solve 共用 LMControl
+        double chi2 = 0.;
+        for (auto &edge: edges_)
+            chi2 += Calls::Chi2(*edge);
+        lm_.Start(chi2, hessianDiagonal_.cwiseAbs().maxCoeff());
+        lm_.RecordLinearizeCost(linearize_cost);
+        summary_.initial_chi2 = chi2;
+
+        const bool has_deadline = options.deadline != std::chrono::steady_clock::time_point::max();
+        StopReason reason = StopReason::MAX_ITERATIONS;
+        while (!lm_.StopBeforeTrial(options, summary_.linear_solves, reason))
+        {
+            if (verbose_ && lm_.Rejections() == 0)
+                std::cout << "iter: " << lm_.Iteration() << " , chi= " << lm_.Chi2()
+                          << " , Lambda= " << lm_.Lambda() << std::endl;
+
+            double trial_start = has_deadline ? t_solve.toc() : 0.;
+            IterationSummary step;
+            step.iteration = lm_.Iteration();
+            step.lambda = lm_.Lambda();
+
+            bool solved = SolveLinearSystem();
+            ++summary_.linear_solves;
+            bool accepted = false;
+            if (solved)
+            {
+                if (delta_x_.squaredNorm() <= 1e-6)
+                {
+                    reason = StopReason::SMALL_STEP;
+                    break;
+                }
+                UpdateStates();
+                double predicted = delta_x_.dot(lm_.Lambda() * delta_x_ + b_);
+                trialChi_ = ComputeChi2();
+                accepted = lm_.TryStep(trialChi_, predicted);
+                if (!accepted)
+                    RollbackStates();
+            }
+            else
+            {
+                // H + lambda I 不正定，当作一次被拒绝的尝试加大 lambda
+                trialChi_ = lm_.Chi2();
+                delta_x_.setZero();
+                lm_.RejectStep();
+            }
+
+            step.chi2 = trialChi_;
+            step.step_norm = delta_x_.norm();
+            step.accepted = accepted;
+            step.time = t_solve.toc();
+            if (has_deadline)
+                lm_.RecordTrialCost(step.time - trial_start);
+            summary_.iterations.push_back(step);
+            bool proceed = !options.callback || options.callback(step);
+            if (lm_.StopAfterTrial(options, accepted, proceed, reason))
+                break;
+            if (!accepted)
+                continue;
+
+            // 残差在计算 chi2 时已经是新状态下的
+            double linearize_start = has_deadline ? t_solve.toc() : 0.;
+            MakeHessian(true);
+            if (has_deadline)
+                lm_.RecordLinearizeCost(t_solve.toc() - linearize_start);
+            SaveStates();
+        }
+        summary_.stop_reason = reason;
+        summary_.final_chi2 = lm_.Chi2();
+        summary_.num_vertices = verticies_.size();
+        summary_.num_edges = edges_.size();
+        summary_.num_parameters = Dim;
+        summary_.total_time = t_solve.toc();
+        if (verbose_)
+            std::cout << summary_.BriefReport() << std::endl;
+        return true;
+    }
+
+    }
+}
+
+#endif
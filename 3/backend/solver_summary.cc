@@ -0,0 +1,54 @@
+#include <sstream>
+#include "backend/solver_summary.h"
+
+namespace myslam
+{
+    namespace backend
+    {
+
+    const char *StopReasonName(StopReason reason)
+    {
+        switch (reason)
+        {
+            case StopReason::NOT_SOLVED: return "not solved";
+            case StopReason::MAX_ITERATIONS: return "max iterations";
+            case StopReason::SMALL_STEP: return "small step";
+            case StopReason::SMALL_CHI2: return "small chi2";
+            case StopReason::TOO_MANY_REJECTIONS: return "too many rejections";
+            case StopReason::MAX_LINEAR_SOLVES: return "max linear solves";
+            case StopReason::DEADLINE: return "deadline";
+            case StopReason::CALLBACK: return "callback";
+        }
+        return "unknown";
+    }
+
+    void SolverSummary::Reset()
+    {
+        std::vector<IterationSummary> kept;
+        kept.swap(iterations);
+        kept.clear();
+        *this = SolverSummary();
+        iterations.swap(kept);
+    }
+
+    std::string SolverSummary::BriefReport() const
+    {
+        int accepted = 0;
+        for (auto &it: iterations)
+            accepted += it.accepted ? 1 : 0;
+
+        std::ostringstream os;
+        os << "vertices: " << num_vertices << ", edges: " << num_edges << ", parameters: " << num_parameters
+           << ", steps: " << accepted << "/" << iterations.size() << ", stop: " << StopReasonName(stop_reason)
+           << ", chi2: " << initial_chi2 << " -> " << final_chi2
+           << ", total: " << total_time << " ms (linearize " << linearization_time
+           << ", damping " << damping_time << ", solve " << linear_solver_time
+           << ", update " << update_time << ", residual " << residual_time << ")"
+           << ", memory: " << allocated_bytes / 1024 << " KB";
+        if (factor_nonzeros > 0)
+            os << ", factor: " << factor_nonzeros << " nnz, " << factor_flops << " flops";
+        return os.str();
+    }
+
+    }
+}
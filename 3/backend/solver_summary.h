@@ -0,0 +1,79 @@
+#ifndef MYSLAM_BACKEND_SOLVER_SUMMARY_H
+#define MYSLAM_BACKEND_SOLVER_SUMMARY_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+namespace myslam
+{
+    namespace backend
+    {
+
+    /// LM 中的一次尝试 (解一次线性方程并更新状态)
+    struct IterationSummary
+    {
+        int iteration = 0;          // 外层迭代序号，被拒绝的尝试与随后被接受的尝试序号相同
+        double chi2 = 0.;           // 尝试后的 chi2
+        double lambda = 0.;         // 本次尝试使用的 lambda
+        double step_norm = 0.;      // |delta_x|
+        double time = 0.;           // 这次尝试结束时距 Solve 开始的时间 (ms)
+        bool accepted = false;
+    };
+
+    /// Solve 停止的原因
+    enum class StopReason
+    {
+        NOT_SOLVED,             // 问题为空，没有求解
+        MAX_ITERATIONS,         // 达到最大迭代次数
+        SMALL_STEP,             // |delta_x| 足够小
+        SMALL_CHI2,             // chi2 降到了阈值以下
+        TOO_MANY_REJECTIONS,    // 连续多次尝试都没有使 chi2 下降
+        MAX_LINEAR_SOLVES,      // 达到解线性方程次数的上限
+        DEADLINE,               // 到了截止时间，或者下一次尝试预计会超时
+        CALLBACK                // 回调要求停止
+    };
+
+    const char *StopReasonName(StopReason reason);
+
+    /**
+     * 一次 Problem::Solve 的统计信息，每次 Solve 开始时清空
+     * 所有时间单位为 ms，由 steady_clock 计时
+     */
+    struct SolverSummary
+    {
+        std::vector<IterationSummary> iterations;
+
+        double initial_chi2 = 0.;
+        double final_chi2 = 0.;
+
+        double total_time = 0.;
+        double linearization_time = 0.;     // MakeHessian: 雅可比及 H、b 的构造
+        double damping_time = 0.;           // 对角线加上、去掉 lambda
+        double linear_solver_time = 0.;     // 解 H dx = b
+        double update_time = 0.;            // 状态更新、快照与回滚
+        double residual_time = 0.;          // 尝试一步后的残差和 chi2
+
+        StopReason stop_reason = StopReason::NOT_SOLVED;
+        int linear_solves = 0;              // 解线性方程的次数，包括被拒绝的尝试
+
+        unsigned long num_vertices = 0;
+        unsigned long num_edges = 0;
+        unsigned long num_parameters = 0;   // 优化变量的维数
+        size_t allocated_bytes = 0;         // Problem 内部求解用的缓存大小
+
+        /// 稀疏分解 (SPARSE 方式) 的因子规模，其他方式为 0
+        long factor_nonzeros = 0;           // L 的非零元个数
+        double factor_flops = 0.;           // 一次分解的浮点运算次数
+
+        /// 清空，iterations 保留容量，重复求解时不再分配
+        void Reset();
+
+        /// 一行的简要报告
+        std::string BriefReport() const;
+    };
+
+    }
+}
+
+#endif
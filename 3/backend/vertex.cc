@@ -1,24 +1,46 @@
 #include "backend/vertex.h"
 #include <iostream>
+#include <algorithm>
+#include <atomic>
 
 namespace myslam
  {
     namespace backend 
     {
-        unsigned long global_vertex_id=0;
+        std::atomic<unsigned long> global_vertex_id(0);
+
+        namespace
+        {
+            /// 每个线程一次从全局计数器取一段 id，段内递增
+            /// 多个线程同时构造顶点时 id 不会重复，单线程中 id 仍按构造顺序递增
+            const unsigned long kIdBlockSize = 1024;
+
+            unsigned long NextVertexId()
+            {
+                thread_local unsigned long next = 0, end = 0;
+                if (next == end)
+                {
+                    next = global_vertex_id.fetch_add(kIdBlockSize, std::memory_order_relaxed);
+                    end = next + kIdBlockSize;
+                }
+                return next++;
+            }
+        }
 
         Vertex::Vertex(int num_dimension,int local_dimension)
         {
             parameters_.resize(num_dimension,1);
+            data_=parameters_.data();
+            dimension_=num_dimension;
             local_dimension_=local_dimension>0? local_dimension:num_dimension;
-            global_vertex_id++;
+            id_=NextVertexId();
         }
 
         Vertex::~Vertex(){}
 
         int Vertex::Dimension() const
         {
-            return parameters_.rows();
+            return dimension_;
         }
 
         int Vertex::LocalDimension() const
@@ -26,9 +48,43 @@ namespace myslam
             return local_dimension_;
         }
 
+        bool Vertex::SetParameters(const VecX &params)
+        {
+            if (IsBound())
+            {
+                // 参数是状态向量中的一段，写多了会覆盖相邻顶点
+                if (params.size() != dimension_)
+                {
+                    std::cerr << "vertex " << id_ << " is bound to a state of dimension " << dimension_
+                              << ", cannot set " << params.size() << " parameters" << std::endl;
+                    return false;
+                }
+                Parameters() = params;
+                return true;
+            }
+            parameters_=params;
+            data_=parameters_.data();
+            dimension_=static_cast<int>(parameters_.size());
+            return true;
+        }
+
         void Vertex::Plus(const VecX &delta)
         {
-            parameters_+=delta;
+            Parameters()+=delta;
+        }
+
+        void Vertex::BindParameters(double *data)
+        {
+            if (data == data_) return;
+            std::copy(data_, data_ + dimension_, data);
+            data_=data;
+        }
+
+        void Vertex::UnbindParameters()
+        {
+            if (!IsBound()) return;
+            std::copy(data_, data_ + dimension_, parameters_.data());
+            data_=parameters_.data();
         }
     }
  }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #ifndef MYSLAM_BACKEND_VERTEX_H
 #define MYSLAM_BACKEND_VERTEX_H
 
+#include <string>
 #include <backend/eigen_types.h>
 
 namespace myslam 
@@ -28,35 +29,57 @@ namespace myslam
         /// 返回变量本地维度
        int LocalDimension() const;
 
+       /// 参数的视图，参数可能存放在顶点自己的存储中，也可能在 Problem 的连续状态向量中
+       /// 注意 const VecX &p = Parameters() 会构造一个临时 VecX，残差里应直接用视图或定长的 Map
+       typedef Eigen::Map<VecX> ParameterMap;
+       typedef Eigen::Map<const VecX> ConstParameterMap;
+
        /// 返回参数值
-      VecX Parameters() const { return parameters_; }
+      ConstParameterMap Parameters() const { return ConstParameterMap(data_, dimension_); }
 
     /// 返回参数值的引用
-     VecX &Parameters() { return parameters_; }
+     ParameterMap Parameters() { return ParameterMap(data_, dimension_); }
 
-       //设置参数
-       void SetParameters(const VecX &params){ parameters_=params;}
+       //设置参数，绑定到状态向量之后维度不能再改变，维度不符时不做修改并返回 false
+       bool SetParameters(const VecX &params);
 
        /// 加法，可重定义
        /// 默认是向量加
        virtual void Plus(const VecX &delta);
 
+       /// Plus 是否就是向量加法，是的话 Problem 会把连续的这类顶点合并成一次向量加
+       /// 重载了 Plus 但 Dimension() == LocalDimension() 的子类，如果不是向量加法需要返回 false
+       virtual bool IsVectorSpace() const { return dimension_ == local_dimension_; }
+
+       /// 把参数搬到外部存储 data 中 (长度为 Dimension())，之后 Parameters() 都指向 data
+       /// 由 Problem 在排列状态向量时调用
+       void BindParameters(double *data);
+
+       /// 参数搬回顶点自己的存储
+       void UnbindParameters();
+
+       /// 参数是否在外部存储中
+       bool IsBound() const { return data_ != parameters_.data(); }
+
+       /// 返回顶点的名称，SLAM 问题中用来区分 pose 和 landmark
+       virtual std::string TypeInfo() const { return "Vertex"; }
+
        
 
     int OrderingId() const { return ordering_id_; }
 
-   // void SetOrderingId(unsigned long id) { ordering_id_ = id; };
+    void SetOrderingId(unsigned long id) { ordering_id_ = id; };
 
     /// 固定该点的估计值
-   // void SetFixed(bool fixed = true) {
-    //    fixed_ = fixed;
-    //}
+    void SetFixed(bool fixed = true) {
+        fixed_ = fixed;
+    }
 
     /// 测试该点是否被固定
     bool IsFixed() const { return fixed_; }
 
     protected:
-        VecX parameters_;//实际存储的变量值
+        int dimension_;//变量维度
         int local_dimension_;//局部参数化维度
         unsigned long id_;//顶点的id,自动生成
 
@@ -67,6 +90,10 @@ namespace myslam
 
     bool fixed_ = false;    // 是否固定
 
+    private:
+        VecX parameters_;//顶点自己的存储，未绑定到状态向量时使用
+        double *data_;//实际存储变量值的位置
+
 
     };
  }
@@ -0,0 +1,27 @@
+#ifndef MYSLAM_BACKEND_VERTEX_INVERSE_DEPTH_H
+#define MYSLAM_BACKEND_VERTEX_INVERSE_DEPTH_H
+
+#include "backend/vertex.h"
+
+namespace myslam
+{
+    namespace backend
+    {
+
+    /**
+     * 以逆深度形式存储的顶点
+     */
+    class VertexInverseDepth : public Vertex
+    {
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+
+        VertexInverseDepth() : Vertex(1) {}
+
+        std::string TypeInfo() const override { return "VertexInverseDepth"; }
+    };
+
+    }
+}
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef MYSLAM_BACKEND_VERTEX_POINT_XYZ_H
+#define MYSLAM_BACKEND_VERTEX_POINT_XYZ_H
+
+#include "backend/vertex.h"
+
+namespace myslam
+{
+    namespace backend
+    {
+
+    /**
+     * @brief 以xyz形式参数化的顶点
+     */
+    class VertexPointXYZ : public Vertex
+    {
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+
+        VertexPointXYZ() : Vertex(3) {}
+
+        std::string TypeInfo() const override { return "VertexPointXYZ"; }
+    };
+
+    }
+}
+
+#endif
@@ -0,0 +1,32 @@
+#include <cmath>
+#include "backend/vertex_pose.h"
+
+namespace myslam
+{
+    namespace backend
+    {
+
+    void VertexPose::Plus(const VecX &delta)
+    {
+        ParameterMap parameters = Parameters();
+        parameters.head<3>() += delta.head<3>();
+
+        Qd q(parameters[6], parameters[3], parameters[4], parameters[5]);
+        Vec3 theta = delta.segment<3>(3);
+        double angle = theta.norm();
+        Qd dq;
+        if (angle < 1e-10)
+            dq = Qd(1., 0.5 * theta[0], 0.5 * theta[1], 0.5 * theta[2]);
+        else
+            dq = Qd(Eigen::AngleAxisd(angle, theta / angle));
+        q = q * dq;
+        q.normalize();
+
+        parameters[3] = q.x();
+        parameters[4] = q.y();
+        parameters[5] = q.z();
+        parameters[6] = q.w();
+    }
+
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef MYSLAM_BACKEND_VERTEX_POSE_H
+#define MYSLAM_BACKEND_VERTEX_POSE_H
+
+#include "backend/vertex.h"
+
+namespace myslam
+{
+    namespace backend
+    {
+
+    /**
+     * Pose 顶点 Twc
+     * parameters: tx, ty, tz, qx, qy, qz, qw, 7 DoF
+     * optimization is perform on manifold, so update is 6 DoF, right multiplication
+     *
+     * pose is represented as Twc in VIO case
+     */
+    class VertexPose : public Vertex
+    {
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+
+        VertexPose() : Vertex(7, 6) {}
+
+        /// 加法，delta 为 [dt, dtheta]，旋转在右侧叠加 R = R * exp(dtheta)
+        virtual void Plus(const VecX &delta) override;
+
+        std::string TypeInfo() const override { return "VertexPose"; }
+    };
+
+    }
+}
+
+#endif
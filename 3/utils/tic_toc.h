@@ -13,15 +13,15 @@ class TicToc
         }
        void tic()
         {
-         start=std::chrono::system_clock::now();
+         start=std::chrono::steady_clock::now();
         }
 
         double toc()
         {
-            end=std::chrono::system_clock::now();
+            end=std::chrono::steady_clock::now();
             std::chrono::duration<double> elapsed_seconds=end-start;
             return elapsed_seconds.count()*1000;
         }
     private:
-        std::chrono::time_point<std::chrono::system_clock> start,end;
+        std::chrono::time_point<std::chrono::steady_clock> start,end;
 };
\ No newline at end of file